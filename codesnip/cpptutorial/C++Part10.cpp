@@ -0,0 +1,298 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// 2D Matrices
+// char myName[5][5] in Part1 is printed one character at a time with
+// nested for loops. That is fine for 25 characters but slow for big grids
+// Matrix<T> keeps every row in one block of memory, one after another
+// Each row starts stride elements after the one before it. The stride is
+// the number of columns rounded up so every row starts on a 64 byte cache
+// line
+// A MatrixView points into a matrix without copying it, so a corner of a
+// big grid can be handed to a function like a matrix of its own
+
+template <typename T>
+class MatrixView{
+
+	private:
+		T* first;
+		size_t numRows;
+		size_t numCols;
+		size_t rowStride;
+
+	public:
+		MatrixView(T* first, size_t rows, size_t cols, size_t stride)
+			: first(first), numRows(rows), numCols(cols), rowStride(stride) {}
+
+		size_t rows() const { return numRows; }
+		size_t cols() const { return numCols; }
+		size_t stride() const { return rowStride; }
+
+		T* row(size_t i) const { return first + i * rowStride; }
+		T& operator()(size_t i, size_t j) const { return first[i * rowStride + j]; }
+
+		// A view of rows [row0, row0 + rows) and columns [col0, col0 + cols)
+		MatrixView sub(size_t row0, size_t col0, size_t rows, size_t cols) const {
+			return MatrixView(first + row0 * rowStride + col0, rows, cols, rowStride);
+		}
+
+		// Every view can be used where a read only view is expected
+		operator MatrixView<const T>() const {
+			return MatrixView<const T>(first, numRows, numCols, rowStride);
+		}
+
+};
+
+template <typename T>
+class Matrix{
+
+	private:
+		size_t numRows;
+		size_t numCols;
+		size_t rowStride;
+		vector <T> storage;
+
+		static size_t paddedCols(size_t cols){
+			size_t perLine = 64 / sizeof(T) > 0 ? 64 / sizeof(T) : 1;
+			return (cols + perLine - 1) / perLine * perLine;
+		}
+
+	public:
+		Matrix(size_t rows, size_t cols, const T& value = T())
+			: numRows(rows), numCols(cols), rowStride(paddedCols(cols)),
+			storage(rows * rowStride + 64 / sizeof(T), value) {}
+
+		// A copied vector can land on a different boundary which would
+		// shift every row, so a Matrix can be moved but not copied
+		Matrix(const Matrix&) = delete;
+		Matrix& operator=(const Matrix&) = delete;
+		Matrix(Matrix&&) = default;
+		Matrix& operator=(Matrix&&) = default;
+
+		size_t rows() const { return numRows; }
+		size_t cols() const { return numCols; }
+
+		// The first row starts on a 64 byte boundary inside storage
+		T* data(){
+			uintptr_t address = reinterpret_cast<uintptr_t>(storage.data());
+			size_t skip = (64 - address % 64) % 64 / sizeof(T);
+			return storage.data() + skip;
+		}
+
+		T* row(size_t i){ return data() + i * rowStride; }
+		T& operator()(size_t i, size_t j){ return data()[i * rowStride + j]; }
+
+		MatrixView<T> view(){ return MatrixView<T>(data(), numRows, numCols, rowStride); }
+
+};
+
+// ---------- TRANSPOSE ----------
+// Transposing reads along rows but writes down columns. Every write in a
+// column lands on a different cache line, so for big grids the naive loop
+// keeps missing the cache
+// The tiled version does one 64 by 64 block at a time. The block's source
+// rows and destination rows both stay in cache while it is copied
+
+template <typename T>
+void transposeNaive(MatrixView<const T> src, MatrixView<T> dst){
+
+	for(size_t i = 0; i < src.rows(); i++)
+		for(size_t j = 0; j < src.cols(); j++)
+			dst(j, i) = src(i, j);
+
+}
+
+template <typename T>
+void transposeTiled(MatrixView<const T> src, MatrixView<T> dst){
+
+	const size_t tile = 64;
+
+	for(size_t i0 = 0; i0 < src.rows(); i0 += tile){
+		size_t iEnd = min(i0 + tile, src.rows());
+		for(size_t j0 = 0; j0 < src.cols(); j0 += tile){
+			size_t jEnd = min(j0 + tile, src.cols());
+			for(size_t i = i0; i < iEnd; i++){
+				const T* srcRow = src.row(i);
+				for(size_t j = j0; j < jEnd; j++) dst(j, i) = srcRow[j];
+			}
+		}
+	}
+
+}
+
+// ---------- ROW OPERATIONS ----------
+
+// Changes a to z into A to Z, 32 characters at a time with AVX2
+void upperCaseRow(char* row, size_t n){
+
+	size_t j = 0;
+
+#ifdef __AVX2__
+	const __m256i beforeA = _mm256_set1_epi8('a' - 1);
+	const __m256i afterZ = _mm256_set1_epi8('z' + 1);
+	const __m256i caseBit = _mm256_set1_epi8(0x20);
+
+	for(; j + 32 <= n; j += 32){
+		__m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + j));
+		__m256i isLower = _mm256_and_si256(_mm256_cmpgt_epi8(chars, beforeA),
+			_mm256_cmpgt_epi8(afterZ, chars));
+		chars = _mm256_xor_si256(chars, _mm256_and_si256(isLower, caseBit));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(row + j), chars);
+	}
+#endif
+
+	for(; j < n; j++) if(row[j] >= 'a' && row[j] <= 'z') row[j] -= 32;
+
+}
+
+// Counts how many times c appears in a row
+size_t countInRow(const char* row, size_t n, char c){
+
+	size_t count = 0;
+	size_t j = 0;
+
+#ifdef __AVX2__
+	const __m256i target = _mm256_set1_epi8(c);
+
+	for(; j + 32 <= n; j += 32){
+		__m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + j));
+		unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chars, target));
+		count += __builtin_popcount(mask);
+	}
+#endif
+
+	for(; j < n; j++) count += (row[j] == c);
+	return count;
+
+}
+
+// dst[j] += src[j] * scale for one row. Plain loops like this are
+// vectorized by the compiler, so number rows don't need intrinsics
+template <typename T>
+void addScaledRow(T* dst, const T* src, size_t n, T scale){
+
+	for(size_t j = 0; j < n; j++) dst[j] += src[j] * scale;
+
+}
+
+// ---------- PRINTING ----------
+// Each row goes out with a single write instead of one << per character
+
+void printGrid(MatrixView<const char> grid){
+
+	string line;
+	for(size_t i = 0; i < grid.rows(); i++){
+		line.assign(grid.row(i), grid.cols());
+		line += '\n';
+		cout.write(line.data(), line.size());
+	}
+
+}
+
+void printGrid(MatrixView<const int> grid){
+
+	string line;
+	for(size_t i = 0; i < grid.rows(); i++){
+		line.clear();
+		for(size_t j = 0; j < grid.cols(); j++){
+			line += to_string(grid(i, j));
+			line += ' ';
+		}
+		line += '\n';
+		cout.write(line.data(), line.size());
+	}
+
+}
+
+// Time how long it takes to run a function in milliseconds
+template <typename Func>
+double timeIt(Func func){
+
+	auto start = chrono::steady_clock::now();
+	func();
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count();
+
+}
+
+int main(int argc, char* argv[]){
+
+	// ---------- THE MYNAME EXAMPLE ----------
+
+	Matrix <char> myName(5, 5, ' ');
+	memcpy(myName.row(0), "Derek", 5);
+	memcpy(myName.row(1), "Banas", 5);
+
+	cout << "2nd Letter in 2nd Array: " << myName(1, 1) << endl;
+	myName(0, 2) = 'e';
+
+	printGrid(myName.view());
+
+	upperCaseRow(myName.row(1), myName.cols());
+
+	Matrix <char> flipped(5, 5);
+	transposeTiled<char>(myName.view(), flipped.view());
+	printGrid(flipped.view());
+
+	// A view of the middle of a number grid
+	Matrix <int> nums(4, 4);
+	for(size_t i = 0; i < 4; i++) for(size_t j = 0; j < 4; j++) nums(i, j) = i * 4 + j;
+	printGrid(nums.view().sub(1, 1, 2, 3));
+
+	// ---------- 8K BY 8K GRIDS ----------
+	// Pass a different size on the command line
+
+	size_t size = (argc > 1) ? atoll(argv[1]) : 8192;
+
+	Matrix <char> grid(size, size);
+	Matrix <char> gridT(size, size);
+
+	for(size_t i = 0; i < size; i++)
+		for(size_t j = 0; j < size; j++) grid(i, j) = 'a' + (i * 7 + j) % 26;
+
+	cout << "Grid of " << size << " by " << size << endl;
+
+	double naive = timeIt([&]{ transposeNaive<char>(grid.view(), gridT.view()); });
+	double tiled = timeIt([&]{ transposeTiled<char>(grid.view(), gridT.view()); });
+
+	cout << "  char transpose naive " << naive << " ms tiled " << tiled << " ms" << endl;
+
+	double upper = timeIt([&]{
+		for(size_t i = 0; i < size; i++) upperCaseRow(grid.row(i), size);
+	});
+
+	size_t numA = 0;
+	double counted = timeIt([&]{
+		for(size_t i = 0; i < size; i++) numA += countInRow(grid.row(i), size, 'A');
+	});
+
+	cout << "  upper case " << upper << " ms, counted " << numA << " A's in "
+		<< counted << " ms" << endl;
+
+	Matrix <int> numbers(size, size, 1);
+	Matrix <int> numbersT(size, size);
+
+	naive = timeIt([&]{ transposeNaive<int>(numbers.view(), numbersT.view()); });
+	tiled = timeIt([&]{ transposeTiled<int>(numbers.view(), numbersT.view()); });
+
+	cout << "  int transpose naive " << naive << " ms tiled " << tiled << " ms" << endl;
+
+	double added = timeIt([&]{
+		for(size_t i = 1; i < size; i++) addScaledRow(numbers.row(i), numbers.row(i - 1), size, 1);
+	});
+
+	cout << "  row adds " << added << " ms" << endl;
+
+	return 0;
+}
@@ -0,0 +1,468 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <map>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <chrono>
+#include "Random.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// A Rules Engine
+// Part1 decides if one person can drive with an if / else if chain
+// To check millions of license records we write the rules as text instead,
+// turn that text into a short list of instructions and run every
+// instruction over a block of 256 records at once
+// Each instruction is a plain loop with no if statements inside, so the
+// compiler turns it into SIMD code and there are no branches to mispredict
+// New rules can be loaded while the program runs without recompiling
+//
+// Rules are checked in order and the first one that matches decides
+//
+//   deny  age >= 1 and age < 16
+//   deny  not isNotIntoxicated
+//   deny  age >= 80 and (age > 100 or age - ageAtLastExam > 5)
+//   allow
+//
+// A rule with no condition always matches
+
+// The records are stored as columns. Every field gets its own array
+struct LicenseColumns{
+
+	vector <int32_t> age;
+	vector <int32_t> ageAtLastExam;
+	vector <uint8_t> isNotIntoxicated;
+
+	size_t size() const { return age.size(); }
+
+};
+
+class RulesEngine{
+
+	private:
+		static constexpr size_t blockSize = 256;
+
+		enum OpCode { LOAD_AGE, LOAD_EXAM_AGE, LOAD_SOBER, CONSTANT,
+			ADD, SUB, LT, LE, GT, GE, EQ, NE, AND, OR, NOT };
+
+		// dst = a op b, working on whole blocks held in registers
+		// When b is -1 the right side is the constant value instead, so
+		// age < 16 doesn't need a block full of 16s
+		struct Instruction{
+			OpCode op;
+			int dst;
+			int a;
+			int b;
+			int32_t value;
+		};
+
+		struct Rule{
+			bool allow;
+			vector <Instruction> code;
+			int result;
+		};
+
+		vector <Rule> rules;
+		int numRegisters = 0;
+
+		// ---------- PARSER ----------
+		// expr := and ('or' and)*
+		// and  := not ('and' not)*
+		// not  := 'not' not | cmp
+		// cmp  := sum (('<' | '<=' | '>' | '>=' | '==' | '!=') sum)?
+		// sum  := atom (('+' | '-') atom)*
+		// atom := number | column | '(' expr ')'
+
+		// The result of parsing part of a rule. Either a register or, when
+		// reg is -1, a constant that hasn't been put in a register yet
+		struct Operand{
+			int reg;
+			int32_t value;
+		};
+
+		struct Parser{
+
+			vector <string> tokens;
+			size_t pos = 0;
+			vector <Instruction>* code;
+			int* numRegisters;
+
+			bool accept(const string& token){
+				if(pos < tokens.size() && tokens[pos] == token){ pos++; return true; }
+				return false;
+			}
+
+			int emit(OpCode op, int a = -1, int b = -1, int32_t value = 0){
+				int dst = (*numRegisters)++;
+				code -> push_back({op, dst, a, b, value});
+				return dst;
+			}
+
+			int toRegister(Operand x){
+				return (x.reg >= 0) ? x.reg : emit(CONSTANT, -1, -1, x.value);
+			}
+
+			Operand binary(OpCode op, Operand left, Operand right){
+				int a = toRegister(left);
+				if(right.reg < 0) return {emit(op, a, -1, right.value), 0};
+				return {emit(op, a, right.reg), 0};
+			}
+
+			Operand parseExpr(){
+				Operand left = parseAnd();
+				while(accept("or")) left = binary(OR, left, parseAnd());
+				return left;
+			}
+
+			Operand parseAnd(){
+				Operand left = parseNot();
+				while(accept("and")) left = binary(AND, left, parseNot());
+				return left;
+			}
+
+			Operand parseNot(){
+				if(accept("not")) return {emit(NOT, toRegister(parseNot())), 0};
+				return parseCompare();
+			}
+
+			Operand parseCompare(){
+				static const map <string, OpCode> compares = {{"<", LT}, {"<=", LE},
+					{">", GT}, {">=", GE}, {"==", EQ}, {"!=", NE}};
+				Operand left = parseSum();
+				if(pos < tokens.size()){
+					auto found = compares.find(tokens[pos]);
+					if(found != compares.end()){
+						pos++;
+						return binary(found -> second, left, parseSum());
+					}
+				}
+				return left;
+			}
+
+			Operand parseSum(){
+				Operand left = parseAtom();
+				while(true){
+					if(accept("+")) left = binary(ADD, left, parseAtom());
+					else if(accept("-")) left = binary(SUB, left, parseAtom());
+					else return left;
+				}
+			}
+
+			Operand parseAtom(){
+				if(pos >= tokens.size()) throw invalid_argument("rule ends too early");
+				string token = tokens[pos++];
+				if(token == "("){
+					Operand inner = parseExpr();
+					if(!accept(")")) throw invalid_argument("missing )");
+					return inner;
+				}
+				// The whole token has to be a number that fits, so "16x" or a
+				// huge literal is a bad rule and not 16 or out_of_range
+				if(isdigit(static_cast<unsigned char>(token[0]))){
+					int32_t value = 0;
+					auto [end, ec] = from_chars(token.data(), token.data() + token.size(), value);
+					if(ec != errc() || end != token.data() + token.size())
+						throw invalid_argument("bad number " + token);
+					return {-1, value};
+				}
+				if(token == "age") return {emit(LOAD_AGE), 0};
+				if(token == "ageAtLastExam") return {emit(LOAD_EXAM_AGE), 0};
+				if(token == "isNotIntoxicated") return {emit(LOAD_SOBER), 0};
+				throw invalid_argument("unknown word " + token);
+			}
+
+		};
+
+		static vector <string> tokenize(const string& line){
+
+			vector <string> tokens;
+			size_t i = 0;
+
+			while(i < line.size()){
+				// The <cctype> tests need an unsigned char or they go wrong
+				// for bytes above 127
+				unsigned char c = line[i];
+				if(isspace(c)){
+					i++;
+				} else if(isalnum(c) || c == '_'){
+					size_t start = i;
+					while(i < line.size() && (isalnum(static_cast<unsigned char>(line[i])) || line[i] == '_')) i++;
+					tokens.push_back(line.substr(start, i - start));
+				} else if((c == '<' || c == '>' || c == '=' || c == '!') &&
+					i + 1 < line.size() && line[i + 1] == '='){
+					tokens.push_back(line.substr(i, 2));
+					i += 2;
+				} else {
+					tokens.push_back(string(1, char(c)));
+					i++;
+				}
+			}
+
+			return tokens;
+
+		}
+
+		// ---------- BLOCK KERNEL ----------
+		// Every loop runs over a whole block of blockSize lanes, even for
+		// the last block, so the compiler knows the trip count and makes
+		// one clean SIMD loop. Lanes past the last record are loaded as 0
+
+		template <typename Column>
+		static void load(int32_t* __restrict d, const Column* src, size_t n){
+			for(size_t i = 0; i < n; i++) d[i] = src[i];
+			for(size_t i = n; i < blockSize; i++) d[i] = 0;
+		}
+
+		template <typename Func>
+		static void apply(int32_t* __restrict d, const int32_t* __restrict a,
+			const int32_t* __restrict b, int32_t value, Func f){
+			if(b) for(size_t i = 0; i < blockSize; i++) d[i] = f(a[i], b[i]);
+			else for(size_t i = 0; i < blockSize; i++) d[i] = f(a[i], value);
+		}
+
+		void runCode(const vector <Instruction>& code, const LicenseColumns& records,
+			size_t start, size_t n, int32_t* regs) const {
+
+			for(const Instruction& in : code){
+
+				int32_t* d = regs + in.dst * blockSize;
+				const int32_t* a = (in.a >= 0) ? regs + in.a * blockSize : nullptr;
+				const int32_t* b = (in.b >= 0) ? regs + in.b * blockSize : nullptr;
+				typedef int32_t I;
+
+				switch(in.op){
+				case LOAD_AGE : load(d, records.age.data() + start, n); break;
+				case LOAD_EXAM_AGE : load(d, records.ageAtLastExam.data() + start, n); break;
+				case LOAD_SOBER : load(d, records.isNotIntoxicated.data() + start, n); break;
+				case CONSTANT : for(size_t i = 0; i < blockSize; i++) d[i] = in.value; break;
+				case ADD : apply(d, a, b, in.value, [](I x, I y){ return x + y; }); break;
+				case SUB : apply(d, a, b, in.value, [](I x, I y){ return x - y; }); break;
+				case LT : apply(d, a, b, in.value, [](I x, I y){ return I(x < y); }); break;
+				case LE : apply(d, a, b, in.value, [](I x, I y){ return I(x <= y); }); break;
+				case GT : apply(d, a, b, in.value, [](I x, I y){ return I(x > y); }); break;
+				case GE : apply(d, a, b, in.value, [](I x, I y){ return I(x >= y); }); break;
+				case EQ : apply(d, a, b, in.value, [](I x, I y){ return I(x == y); }); break;
+				case NE : apply(d, a, b, in.value, [](I x, I y){ return I(x != y); }); break;
+				case AND : apply(d, a, b, in.value, [](I x, I y){ return I((x != 0) & (y != 0)); }); break;
+				case OR : apply(d, a, b, in.value, [](I x, I y){ return I((x != 0) | (y != 0)); }); break;
+				case NOT : apply(d, a, nullptr, 0, [](I x, I){ return I(x == 0); }); break;
+				}
+
+			}
+
+		}
+
+		// Turns 64 lanes holding 0 or 1 into the bits of one word
+		static uint64_t packBits(const int32_t* lanes){
+
+			uint64_t word = 0;
+
+#ifdef __AVX2__
+			for(int j = 0; j < 64; j += 8){
+				__m256i v = _mm256_slli_epi32(
+					_mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes + j)), 31);
+				word |= (uint64_t) _mm256_movemask_ps(_mm256_castsi256_ps(v)) << j;
+			}
+#else
+			for(int j = 0; j < 64; j++) word |= (uint64_t) (lanes[j] & 1) << j;
+#endif
+
+			return word;
+
+		}
+
+	public:
+		RulesEngine() {}
+		explicit RulesEngine(const string& text){ load(text); }
+
+		// Replaces the rules with the ones in text, one rule per line
+		// Nothing changes if the text has an error
+		void load(const string& text){
+
+			vector <Rule> newRules;
+			int newNumRegisters = 0;
+			size_t lineStart = 0;
+
+			while(lineStart <= text.size()){
+
+				size_t lineEnd = text.find('\n', lineStart);
+				if(lineEnd == string::npos) lineEnd = text.size();
+				vector <string> tokens = tokenize(text.substr(lineStart, lineEnd - lineStart));
+				lineStart = lineEnd + 1;
+
+				if(tokens.empty()) continue;
+
+				Rule rule;
+				if(tokens[0] == "allow") rule.allow = true;
+				else if(tokens[0] == "deny") rule.allow = false;
+				else throw invalid_argument("rules start with allow or deny");
+
+				Parser parser;
+				parser.tokens = tokens;
+				parser.pos = 1;
+				parser.code = &rule.code;
+				parser.numRegisters = &newNumRegisters;
+
+				if(tokens.size() == 1) rule.result = parser.emit(CONSTANT, -1, -1, 1);
+				else rule.result = parser.toRegister(parser.parseExpr());
+
+				if(parser.pos != tokens.size())
+					throw invalid_argument("unexpected " + tokens[parser.pos]);
+
+				newRules.push_back(rule);
+
+			}
+
+			rules.swap(newRules);
+			numRegisters = newNumRegisters;
+
+		}
+
+		// Bit i of the result is 1 if record i is allowed
+		// Records that no rule matches are denied
+		vector <uint64_t> evaluate(const LicenseColumns& records) const {
+
+			size_t total = records.size();
+			vector <uint64_t> bitmap((total + 63) / 64, 0);
+			vector <int32_t> regs(numRegisters * blockSize);
+			vector <int32_t> decided(blockSize), allowed(blockSize);
+
+			for(size_t start = 0; start < total; start += blockSize){
+
+				size_t n = min(blockSize, total - start);
+				fill(decided.begin(), decided.end(), 0);
+				fill(allowed.begin(), allowed.end(), 0);
+
+				for(const Rule& rule : rules){
+					runCode(rule.code, records, start, n, regs.data());
+					const int32_t* hit = &regs[rule.result * blockSize];
+					int32_t allowBit = rule.allow;
+					for(size_t i = 0; i < blockSize; i++){
+						int32_t first = (hit[i] != 0) & (decided[i] ^ 1);
+						allowed[i] |= first & allowBit;
+						decided[i] |= first;
+					}
+				}
+
+				// blockSize is a multiple of 64 so every word belongs to one block
+				for(size_t w = 0; w * 64 < n; w++)
+					bitmap[start / 64 + w] = packBits(&allowed[w * 64]);
+
+			}
+
+			// The padding lanes of the last block aren't records
+			if(total % 64) bitmap.back() &= (1ULL << (total % 64)) - 1;
+
+			return bitmap;
+
+		}
+
+};
+
+// The Part1 if / else if chain for one person
+bool canDrive(int age, int ageAtLastExam, bool isNotIntoxicated){
+
+	if((age >= 1) && (age < 16)){
+		return false;
+	} else if(!isNotIntoxicated){
+		return false;
+	} else if(age >= 80 && ((age > 100) || ((age - ageAtLastExam) > 5))){
+		return false;
+	} else {
+		return true;
+	}
+
+}
+
+int main(int argc, char* argv[]){
+
+	const string drivingRules =
+		"deny age >= 1 and age < 16\n"
+		"deny not isNotIntoxicated\n"
+		"deny age >= 80 and (age > 100 or age - ageAtLastExam > 5)\n"
+		"allow\n";
+
+	RulesEngine engine(drivingRules);
+
+	// ---------- THE PART1 PERSON ----------
+
+	LicenseColumns person;
+	person.age = {70};
+	person.ageAtLastExam = {16};
+	person.isNotIntoxicated = {1};
+
+	bool allowed = engine.evaluate(person)[0] & 1;
+	cout << (allowed ? "You can drive" : "You can't drive") << endl;
+
+	// ---------- MILLIONS OF RECORDS ----------
+
+	size_t numRecords = (argc > 1) ? atoll(argv[1]) : 10000000;
+
+	Xoshiro256pp gen(2024);
+	LicenseColumns records;
+	records.age.resize(numRecords);
+	records.ageAtLastExam.resize(numRecords);
+	records.isNotIntoxicated.resize(numRecords);
+
+	for(size_t i = 0; i < numRecords; i++){
+		records.age[i] = uniformInt(gen, 1, 110);
+		records.ageAtLastExam[i] = records.age[i] - uniformInt(gen, 0, 10);
+		records.isNotIntoxicated[i] = uniformInt(gen, 1, 10) != 1;
+	}
+
+	auto start = chrono::steady_clock::now();
+	vector <uint64_t> bitmap = engine.evaluate(records);
+	chrono::duration<double, milli> engineTime = chrono::steady_clock::now() - start;
+
+	start = chrono::steady_clock::now();
+	vector <uint64_t> expected(bitmap.size(), 0);
+	for(size_t i = 0; i < numRecords; i++){
+		if(canDrive(records.age[i], records.ageAtLastExam[i], records.isNotIntoxicated[i]))
+			expected[i / 64] |= 1ULL << (i % 64);
+	}
+	chrono::duration<double, milli> chainTime = chrono::steady_clock::now() - start;
+
+	long long drivers = 0;
+	for(uint64_t word : bitmap) drivers += __builtin_popcountll(word);
+
+	cout << drivers << " of " << numRecords << " can drive" << endl;
+	cout << "Rules engine " << engineTime.count() << " ms, if chain "
+		<< chainTime.count() << " ms" << endl;
+	cout << "Results match " << (bitmap == expected) << endl;
+
+	// ---------- RELOADING ----------
+	// Raise the age limit without recompiling
+
+	engine.load("deny age < 18\ndeny not isNotIntoxicated\nallow");
+	bitmap = engine.evaluate(records);
+	drivers = 0;
+	for(uint64_t word : bitmap) drivers += __builtin_popcountll(word);
+	cout << "With the new rules " << drivers << " can drive" << endl;
+
+	// A bad rule is rejected and the old rules stay
+	try{
+		engine.load("deny height > 200");
+	}
+	catch(invalid_argument& e){
+		cout << "Rule not loaded : " << e.what() << endl;
+	}
+
+	for(string badNumber : {"deny age < 16x", "deny age < 99999999999"}){
+		try{
+			engine.load(badNumber);
+		}
+		catch(invalid_argument& e){
+			cout << "Rule not loaded : " << e.what() << endl;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,463 @@
+#include <iostream>
+#include <array>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+using namespace std;
+
+// Looking Up Greetings
+// The switch in Part1 knows 3 greetings. To greet people in hundreds of
+// languages we look the greeting up by locale code like "fr" or "pt_BR"
+//
+// Built in locales live in a table the compiler builds. It searches for a
+// hash seed that puts every locale in its own slot (a perfect hash), so a
+// lookup is one multiply, one shift and one compare
+// More locales come from a locale pack file. The file holds the same kind
+// of table plus the strings, and we map it into memory with mmap so the
+// strings are used right where they sit in the file
+// Lookups return a string_view and never allocate
+
+// Locale codes of up to 8 characters are packed into one 64 bit number so
+// they can be hashed and compared in one step
+constexpr uint64_t packLocale(string_view locale){
+
+	uint64_t key = 0;
+	for(size_t i = 0; i < locale.size() && i < 8; i++)
+		key |= uint64_t(static_cast<unsigned char>(locale[i])) << (8 * i);
+	return key;
+
+}
+
+constexpr uint32_t slotFor(uint64_t key, uint64_t seed, int bits){
+
+	uint64_t h = (key ^ (key >> 31)) * seed;
+	return static_cast<uint32_t>(h >> (64 - bits));
+
+}
+
+// Try seeds until one gives every key its own slot. Used both by the
+// compiler for the built in table and at run time to build a pack file
+// Gives up after maxSeedTries seeds and returns false. Keys that are all
+// different rarely need more than a few thousand, but equal keys never
+// get their own slots however long we look
+constexpr int maxSeedTries = 20000;
+
+template <typename Slots>
+constexpr bool findSeed(const uint64_t* keys, size_t count, int bits, Slots& slots, uint64_t& seed){
+
+	seed = 0x9e3779b97f4a7c15ULL;
+	for(size_t s = 0; s < slots.size(); s++) slots[s] = -1;
+
+	for(int tries = 0; tries < maxSeedTries; tries++){
+
+		size_t placed = 0;
+		while(placed < count){
+			uint32_t slot = slotFor(keys[placed], seed, bits);
+			if(slots[slot] >= 0) break;
+			slots[slot] = static_cast<int32_t>(placed++);
+		}
+
+		if(placed == count) return true;
+
+		// Empty only the slots this seed filled, not the whole table
+		for(size_t i = 0; i < placed; i++) slots[slotFor(keys[i], seed, bits)] = -1;
+		seed += 0x632be59bd9b4e019ULL;
+
+	}
+
+	return false;
+
+}
+
+// ---------- BUILT IN LOCALES ----------
+
+struct Greeting{
+	string_view locale;
+	string_view text;
+};
+
+constexpr Greeting builtInGreetings[] = {
+	{"en", "Hello"}, {"fr", "Bonjour"}, {"es", "Hola"}, {"de", "Hallo"},
+	{"it", "Ciao"}, {"pt", "Ola"}, {"pt_BR", "Oi"}, {"nl", "Hallo"},
+	{"sv", "Hej"}, {"da", "Hej"}, {"no", "Hei"}, {"fi", "Hei"},
+	{"pl", "Czesc"}, {"cs", "Ahoj"}, {"tr", "Merhaba"}, {"id", "Halo"},
+	{"sw", "Jambo"}, {"hi", "Namaste"}, {"bn", "Nomoskar"}, {"ja", "Konnichiwa"},
+	{"zh", "Ni hao"}, {"ko", "Annyeong"}, {"haw", "Aloha"}, {"mi", "Kia ora"}
+};
+
+constexpr size_t numBuiltIns = sizeof(builtInGreetings) / sizeof(Greeting);
+
+// Twice as many slots as keys keeps the seed search short
+constexpr int builtInBits = 6;
+
+struct BuiltInTable{
+	uint64_t seed;
+	array <uint64_t, 1 << builtInBits> keys;
+	array <int32_t, 1 << builtInBits> index;
+};
+
+constexpr BuiltInTable buildBuiltInTable(){
+
+	BuiltInTable table = {};
+	uint64_t keys[numBuiltIns] = {};
+	for(size_t i = 0; i < numBuiltIns; i++) keys[i] = packLocale(builtInGreetings[i].locale);
+
+	// Throwing here stops the compile if no seed is found
+	if(!findSeed(keys, numBuiltIns, builtInBits, table.index, table.seed))
+		throw logic_error("no seed fits the built in locales");
+	for(size_t s = 0; s < table.keys.size(); s++)
+		table.keys[s] = (table.index[s] >= 0) ? keys[table.index[s]] : 0;
+	return table;
+
+}
+
+// Worked out by the compiler. Nothing runs at startup
+constexpr BuiltInTable builtInTable = buildBuiltInTable();
+
+constexpr string_view lookupBuiltIn(uint64_t key){
+
+	uint32_t slot = slotFor(key, builtInTable.seed, builtInBits);
+	if(builtInTable.keys[slot] != key || builtInTable.index[slot] < 0) return string_view();
+	return builtInGreetings[builtInTable.index[slot]].text;
+
+}
+
+static_assert(lookupBuiltIn(packLocale("fr")) == "Bonjour", "the built in table works at compile time");
+
+// ---------- LOCALE PACK FILES ----------
+// Header, then 2^bits slots, then all the strings one after another
+//
+// | magic | bits | seed | slot 0 ... slot 2^bits-1 | string bytes |
+//
+// A slot holds the packed locale and where its greeting starts in the
+// string bytes. An empty slot has a key of 0
+
+struct PackHeader{
+	char magic[4];
+	uint32_t bits;
+	uint64_t seed;
+};
+
+struct PackSlot{
+	uint64_t key;
+	uint32_t offset;
+	uint32_t length;
+};
+
+// Locale codes have to be 1 to 8 characters and all different, since
+// packLocale only keeps 8 and a key of 0 marks an empty slot
+void writeLocalePack(const string& fileName, const vector <pair<string, string>>& greetings){
+
+	vector <uint64_t> keys;
+	for(const auto& g : greetings){
+		if(g.first.empty() || g.first.size() > 8)
+			throw invalid_argument("locale code \"" + g.first + "\" is not 1 to 8 characters");
+		keys.push_back(packLocale(g.first));
+	}
+
+	vector <uint64_t> sorted = keys;
+	sort(sorted.begin(), sorted.end());
+	auto repeated = adjacent_find(sorted.begin(), sorted.end());
+	if(repeated != sorted.end()){
+		char code[9] = {};
+		for(int i = 0; i < 8; i++) code[i] = char(*repeated >> (8 * i));
+		throw invalid_argument("locale code \"" + string(code) + "\" is in the pack twice");
+	}
+
+	// Start with twice as many slots as keys. If no seed works, doubling
+	// the table makes one much easier to find
+	int bits = 1;
+	while((1u << bits) < greetings.size() * 2) bits++;
+
+	vector <int32_t> index;
+	PackHeader header = {{'G', 'R', 'T', '1'}, 0, 0};
+	while(true){
+		if(bits > 24) throw runtime_error("no hash seed fits the locales of " + fileName);
+		index.resize(size_t(1) << bits);
+		if(findSeed(keys.data(), keys.size(), bits, index, header.seed)) break;
+		bits++;
+	}
+	header.bits = static_cast<uint32_t>(bits);
+
+	vector <PackSlot> slots(1 << bits, PackSlot{0, 0, 0});
+	string strings;
+
+	for(size_t s = 0; s < slots.size(); s++){
+		if(index[s] < 0) continue;
+		const string& text = greetings[index[s]].second;
+		slots[s] = {keys[index[s]], static_cast<uint32_t>(strings.size()),
+			static_cast<uint32_t>(text.size())};
+		strings += text;
+	}
+
+	ofstream writer(fileName, ios::binary | ios::trunc);
+	if(! writer) throw runtime_error("can't write " + fileName);
+
+	writer.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	writer.write(reinterpret_cast<const char*>(slots.data()), slots.size() * sizeof(PackSlot));
+	writer.write(strings.data(), strings.size());
+
+}
+
+// A locale pack mapped into memory. The greetings it returns point into
+// the mapping so they are valid as long as the LocalePack is
+class LocalePack{
+
+	private:
+		void* mapping = MAP_FAILED;
+		size_t mappedSize = 0;
+		const PackHeader* header = nullptr;
+		const PackSlot* slots = nullptr;
+		const char* strings = nullptr;
+
+	public:
+		explicit LocalePack(const string& fileName){
+
+			int fd = open(fileName.c_str(), O_RDONLY);
+			if(fd < 0) throw runtime_error("can't open " + fileName);
+
+			struct stat info;
+			if(fstat(fd, &info) != 0 || info.st_size < (off_t) sizeof(PackHeader)){
+				close(fd);
+				throw runtime_error(fileName + " is not a locale pack");
+			}
+
+			mappedSize = info.st_size;
+			mapping = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+			close(fd);
+			if(mapping == MAP_FAILED) throw runtime_error("can't map " + fileName);
+
+			header = static_cast<const PackHeader*>(mapping);
+
+			// slotFor shifts by 64 - bits, so 0 bits would shift by 64
+			if(memcmp(header -> magic, "GRT1", 4) == 0 && (header -> bits == 0 || header -> bits > 24)){
+				uint32_t bits = header -> bits;
+				munmap(mapping, mappedSize);
+				throw invalid_argument(fileName + " has a table of " + to_string(bits) + " bits, not 1 to 24");
+			}
+
+			bool valid = memcmp(header -> magic, "GRT1", 4) == 0;
+			size_t tableEnd = valid ? sizeof(PackHeader) + (sizeof(PackSlot) << header -> bits) : 0;
+			valid = valid && tableEnd <= mappedSize;
+
+			// Every greeting has to lie inside the file
+			if(valid){
+				slots = reinterpret_cast<const PackSlot*>(header + 1);
+				for(size_t s = 0; s < (size_t(1) << header -> bits) && valid; s++)
+					valid = (uint64_t) slots[s].offset + slots[s].length <= mappedSize - tableEnd;
+			}
+
+			if(!valid){
+				munmap(mapping, mappedSize);
+				throw runtime_error(fileName + " is not a locale pack");
+			}
+
+			strings = static_cast<const char*>(mapping) + tableEnd;
+
+		}
+
+		LocalePack(const LocalePack&) = delete;
+		LocalePack& operator=(const LocalePack&) = delete;
+
+		~LocalePack(){ if(mapping != MAP_FAILED) munmap(mapping, mappedSize); }
+
+		string_view lookup(uint64_t key) const {
+			const PackSlot& slot = slots[slotFor(key, header -> seed, header -> bits)];
+			if(slot.key != key || key == 0) return string_view();
+			return string_view(strings + slot.offset, slot.length);
+		}
+
+		// Where the slot for key is, so a batch can prefetch it
+		const void* slotAddress(uint64_t key) const {
+			return &slots[slotFor(key, header -> seed, header -> bits)];
+		}
+
+};
+
+// ---------- THE GREETING STORE ----------
+// Checks the locale packs first so they can override a built in greeting,
+// then the built in table, then falls back to Hello like the default case
+
+class GreetingStore{
+
+	private:
+		vector <const LocalePack*> packs;
+
+	public:
+		void addPack(const LocalePack& pack){ packs.insert(packs.begin(), &pack); }
+
+		string_view greet(uint64_t key) const {
+			for(const LocalePack* pack : packs){
+				string_view found = pack -> lookup(key);
+				if(!found.empty()) return found;
+			}
+			string_view found = lookupBuiltIn(key);
+			return found.empty() ? string_view("Hello") : found;
+		}
+
+		// Codes longer than 8 characters can't be in any table, and packing
+		// them would cut them down to some other code
+		string_view greet(string_view locale) const {
+			return (locale.size() > 8) ? greet(uint64_t(0)) : greet(packLocale(locale));
+		}
+
+		// Looks up n locales. The pack slots for a group of keys are
+		// prefetched before any of them is read, so the cache misses of
+		// the group overlap instead of happening one after another
+		// That pays off for packs too big to stay in cache. Small packs
+		// are already in cache and gain nothing
+		void greetMany(const uint64_t* keys, size_t n, string_view* out) const {
+
+			const size_t group = 16;
+
+			for(size_t start = 0; start < n; start += group){
+				size_t end = min(n, start + group);
+				for(const LocalePack* pack : packs)
+					for(size_t i = start; i < end; i++) __builtin_prefetch(pack -> slotAddress(keys[i]));
+				for(size_t i = start; i < end; i++) out[i] = greet(keys[i]);
+			}
+
+		}
+
+};
+
+int main(){
+
+	GreetingStore store;
+
+	// ---------- THE PART1 SWITCH ----------
+	// greetingOption 1, 2 and 3 are just locales now
+
+	const char* optionLocales[] = {"en", "fr", "es", "de"};
+	const int numOptions = sizeof(optionLocales) / sizeof(optionLocales[0]);
+	int greetingOption = 2;
+
+	// Any other option gets the default locale like the default case
+	auto optionLocale = [&](int option){
+		return (option >= 0 && option < numOptions) ? optionLocales[option] : optionLocales[0];
+	};
+
+	cout << store.greet(optionLocale(greetingOption)) << " " << store.greet(optionLocale(7)) << endl;
+
+	// ---------- A LOCALE PACK ----------
+	// Write a pack with a few hundred made up regional locales and map it
+
+	vector <pair<string, string>> regional = {{"en_AU", "G'day"}, {"es_MX", "Que onda"}};
+	for(int i = 0; i < 300; i++) regional.push_back({"x" + to_string(i), "Greeting " + to_string(i)});
+
+	writeLocalePack("greetings.pack", regional);
+	LocalePack pack("greetings.pack");
+	store.addPack(pack);
+
+	cout << store.greet("en_AU") << " " << store.greet("es_MX") << " " << store.greet("x42")
+		<< " " << store.greet("haw") << " " << store.greet("unknown") << endl;
+
+	try{
+		LocalePack missing("missing.pack");
+	}
+	catch(runtime_error& e){
+		cout << e.what() << endl;
+	}
+
+	// A damaged pack that claims a table of 0 bits
+	{
+		PackHeader broken = {{'G', 'R', 'T', '1'}, 0, 0};
+		ofstream writer("broken.pack", ios::binary | ios::trunc);
+		writer.write(reinterpret_cast<const char*>(&broken), sizeof(broken));
+	}
+
+	try{
+		LocalePack broken("broken.pack");
+	}
+	catch(invalid_argument& e){
+		cout << e.what() << endl;
+	}
+	remove("broken.pack");
+
+	// Codes that only differ after 8 characters would pack to the same key
+	try{
+		writeLocalePack("taiwan.pack", {{"zh_Hant_TW", "Ni hao"}, {"zh_Hant_HK", "Nei hou"}});
+	}
+	catch(invalid_argument& e){
+		cout << e.what() << endl;
+	}
+
+	try{
+		writeLocalePack("twice.pack", {{"en_AU", "G'day"}, {"en_AU", "Hiya"}});
+	}
+	catch(invalid_argument& e){
+		cout << e.what() << endl;
+	}
+
+	// A long code is not cut down to en_AU_xx
+	cout << store.greet("en_AU_xxxx") << endl;
+
+	// 200 locales can be more than twice as many slots can take, so the
+	// table grows until a seed fits
+	vector <pair<string, string>> many;
+	for(int i = 0; i < 200; i++) many.push_back({"l" + to_string(i * 37) + "_X", "Greeting " + to_string(i)});
+	writeLocalePack("many.pack", many);
+	{
+		LocalePack manyPack("many.pack");
+		bool allFound = true;
+		for(const auto& g : many) allFound = allFound && manyPack.lookup(packLocale(g.first)) == g.second;
+		cout << "All 200 locales found " << boolalpha << allFound << endl;
+	}
+	remove("many.pack");
+
+	// ---------- SPEED ----------
+
+	vector <string> allLocales;
+	for(const Greeting& g : builtInGreetings) allLocales.push_back(string(g.locale));
+	for(const auto& g : regional) allLocales.push_back(g.first);
+
+	unordered_map <string, string> mapStore;
+	for(const Greeting& g : builtInGreetings) mapStore[string(g.locale)] = string(g.text);
+	for(const auto& g : regional) mapStore[g.first] = g.second;
+
+	const size_t numLookups = 10000000;
+	vector <uint64_t> keys(numLookups);
+	vector <string> names(numLookups);
+	for(size_t i = 0; i < numLookups; i++){
+		names[i] = allLocales[(i * 7919) % allLocales.size()];
+		keys[i] = packLocale(names[i]);
+	}
+
+	vector <string_view> out(numLookups);
+	size_t totalLength = 0;
+
+	auto start = chrono::steady_clock::now();
+	for(size_t i = 0; i < numLookups; i++) totalLength += mapStore.find(names[i]) -> second.size();
+	chrono::duration<double, nano> mapTime = chrono::steady_clock::now() - start;
+
+	start = chrono::steady_clock::now();
+	for(size_t i = 0; i < numLookups; i++) out[i] = store.greet(keys[i]);
+	chrono::duration<double, nano> oneTime = chrono::steady_clock::now() - start;
+
+	start = chrono::steady_clock::now();
+	store.greetMany(keys.data(), numLookups, out.data());
+	chrono::duration<double, nano> batchTime = chrono::steady_clock::now() - start;
+
+	for(string_view g : out) totalLength -= g.size();
+
+	cout << "unordered_map " << mapTime.count() / numLookups << " ns per lookup" << endl;
+	cout << "GreetingStore " << oneTime.count() / numLookups << " ns per lookup" << endl;
+	cout << "greetMany     " << batchTime.count() / numLookups << " ns per lookup" << endl;
+	cout << "Same greetings " << (totalLength == 0) << endl;
+
+	remove("greetings.pack");
+
+	return 0;
+}
@@ -0,0 +1,367 @@
+#include <iostream>
+#include <vector>
+#include <queue>
+#include <thread>
+#include <limits>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include "Random.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// Min, Max and Where They Are
+// int largestNum = (5 > 2) ? 5 : 2; in Part1 finds the bigger of 2 numbers
+// Here we find the smallest and biggest of hundreds of millions, and also
+// where they are (argmin / argmax) and the k biggest (top k)
+// With AVX2 one instruction compares 8 ints or floats. Several threads each
+// take a slice of the array and the slice results are combined at the end
+//
+// NaN (not a number) floats are skipped. Comparisons with NaN are always
+// false so a NaN never becomes the min or max. Extremes counts them so you
+// can tell that some were there
+
+template <typename T>
+struct Extremes{
+	T min;
+	T max;
+	size_t nanCount;
+};
+
+// ---------- SCALAR VERSIONS ----------
+// These handle machines without AVX2 and the last few elements
+
+template <typename T>
+void scalarExtremes(const T* data, size_t n, Extremes<T>& result){
+
+	for(size_t i = 0; i < n; i++){
+		T x = data[i];
+		if(x != x){ result.nanCount++; continue; }
+		if(x < result.min) result.min = x;
+		if(x > result.max) result.max = x;
+	}
+
+}
+
+// Index of the first largest (FindMax) or smallest element, or n if there
+// is none because every element is NaN
+template <bool FindMax, typename T>
+size_t scalarArgExtreme(const T* data, size_t n){
+
+	size_t best = n;
+	for(size_t i = 0; i < n; i++){
+		T x = data[i];
+		if(x != x) continue;
+		if(best == n || (FindMax ? x > data[best] : x < data[best])) best = i;
+	}
+	return best;
+
+}
+
+// ---------- MIN AND MAX ----------
+
+template <typename T>
+Extremes<T> findExtremes(const T* data, size_t n){
+
+	Extremes<T> result = {numeric_limits<T>::has_infinity ? numeric_limits<T>::infinity()
+		: numeric_limits<T>::max(), numeric_limits<T>::has_infinity ?
+		-numeric_limits<T>::infinity() : numeric_limits<T>::lowest(), 0};
+	size_t i = 0;
+
+#ifdef __AVX2__
+	if constexpr(is_same<T, int32_t>::value){
+		// 2 sets of accumulators so one min doesn't wait on the one before
+		__m256i lo0 = _mm256_set1_epi32(result.min), lo1 = lo0;
+		__m256i hi0 = _mm256_set1_epi32(result.max), hi1 = hi0;
+		for(; i + 16 <= n; i += 16){
+			__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+			__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 8));
+			lo0 = _mm256_min_epi32(lo0, a); hi0 = _mm256_max_epi32(hi0, a);
+			lo1 = _mm256_min_epi32(lo1, b); hi1 = _mm256_max_epi32(hi1, b);
+		}
+		alignas(32) int32_t lanes[8];
+		_mm256_store_si256(reinterpret_cast<__m256i*>(lanes), _mm256_min_epi32(lo0, lo1));
+		for(int32_t x : lanes) result.min = min(result.min, x);
+		_mm256_store_si256(reinterpret_cast<__m256i*>(lanes), _mm256_max_epi32(hi0, hi1));
+		for(int32_t x : lanes) result.max = max(result.max, x);
+	} else if constexpr(is_same<T, float>::value){
+		// _mm256_min_ps(x, acc) gives acc back when x is NaN, so NaNs are
+		// skipped for free. They are counted with an unordered compare
+		__m256 lo = _mm256_set1_ps(result.min), hi = _mm256_set1_ps(result.max);
+		__m256i nans = _mm256_setzero_si256();
+		for(; i + 8 <= n; i += 8){
+			__m256 x = _mm256_loadu_ps(data + i);
+			lo = _mm256_min_ps(x, lo);
+			hi = _mm256_max_ps(x, hi);
+			nans = _mm256_sub_epi32(nans, _mm256_castps_si256(_mm256_cmp_ps(x, x, _CMP_UNORD_Q)));
+		}
+		alignas(32) float lanes[8];
+		_mm256_store_ps(lanes, lo);
+		for(float x : lanes) result.min = min(result.min, x);
+		_mm256_store_ps(lanes, hi);
+		for(float x : lanes) result.max = max(result.max, x);
+		alignas(32) int32_t counts[8];
+		_mm256_store_si256(reinterpret_cast<__m256i*>(counts), nans);
+		for(int32_t c : counts) result.nanCount += c;
+	}
+#endif
+
+	scalarExtremes(data + i, n - i, result);
+	return result;
+
+}
+
+// ---------- ARGMIN AND ARGMAX ----------
+// Each lane remembers the best value it has seen and its index. A compare
+// makes a mask of the lanes that found something better and blend copies
+// the new value and index into just those lanes
+// The strict compare keeps the first index when values tie, and at the end
+// the lanes are checked for the best value with the smallest index
+
+template <bool FindMax, typename T>
+size_t argExtreme(const T* data, size_t n){
+
+	size_t best = n;
+	size_t i = 0;
+
+#ifdef __AVX2__
+	if constexpr(is_same<T, int32_t>::value || is_same<T, float>::value){
+
+		// Indexes are kept in 32 bit lanes so go a billion elements at a time
+		const size_t block = size_t(1) << 30;
+
+		for(; i + 8 <= n; ){
+
+			size_t blockEnd = min(n, i + block) & ~size_t(7);
+			if(blockEnd - i < 8) break;
+			size_t base = i;
+
+			__m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+			__m256i bestIndex = _mm256_set1_epi32(-1);
+			const __m256i step = _mm256_set1_epi32(8);
+			alignas(32) T values[8];
+			alignas(32) int32_t indexes[8];
+
+			if constexpr(is_same<T, int32_t>::value){
+				__m256i bestValue = _mm256_set1_epi32(FindMax ? INT32_MIN : INT32_MAX);
+				for(; i < blockEnd; i += 8){
+					__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+					__m256i better = FindMax ? _mm256_cmpgt_epi32(x, bestValue)
+						: _mm256_cmpgt_epi32(bestValue, x);
+					// The first element of a lane always counts even if it
+					// equals the starting value
+					better = _mm256_or_si256(better, _mm256_cmpeq_epi32(bestIndex, _mm256_set1_epi32(-1)));
+					bestValue = _mm256_blendv_epi8(bestValue, x, better);
+					bestIndex = _mm256_blendv_epi8(bestIndex, index, better);
+					index = _mm256_add_epi32(index, step);
+				}
+				_mm256_store_si256(reinterpret_cast<__m256i*>(values), bestValue);
+			} else {
+				__m256 bestValue = _mm256_set1_ps(FindMax ? -INFINITY : INFINITY);
+				for(; i < blockEnd; i += 8){
+					__m256 x = _mm256_loadu_ps(data + i);
+					// Ordered compares are false for NaN so NaNs never win
+					__m256 better = FindMax ? _mm256_cmp_ps(x, bestValue, _CMP_GT_OQ)
+						: _mm256_cmp_ps(x, bestValue, _CMP_LT_OQ);
+					__m256 unset = _mm256_castsi256_ps(_mm256_cmpeq_epi32(bestIndex, _mm256_set1_epi32(-1)));
+					better = _mm256_or_ps(better, _mm256_and_ps(unset, _mm256_cmp_ps(x, x, _CMP_ORD_Q)));
+					bestValue = _mm256_blendv_ps(bestValue, x, better);
+					bestIndex = _mm256_castps_si256(_mm256_blendv_ps(
+						_mm256_castsi256_ps(bestIndex), _mm256_castsi256_ps(index), better));
+					index = _mm256_add_epi32(index, step);
+				}
+				_mm256_store_ps(values, bestValue);
+			}
+
+			_mm256_store_si256(reinterpret_cast<__m256i*>(indexes), bestIndex);
+
+			for(int lane = 0; lane < 8; lane++){
+				if(indexes[lane] < 0) continue;
+				size_t candidate = base + indexes[lane];
+				T value = values[lane];
+				if(best == n || (FindMax ? value > data[best] : value < data[best]) ||
+					(value == data[best] && candidate < best)) best = candidate;
+			}
+
+		}
+	}
+#endif
+
+	size_t rest = scalarArgExtreme<FindMax>(data + i, n - i);
+	if(rest < n - i){
+		size_t candidate = i + rest;
+		if(best == n || (FindMax ? data[candidate] > data[best] : data[candidate] < data[best]))
+			best = candidate;
+	}
+	return best;
+
+}
+
+template <typename T> size_t argMax(const T* data, size_t n){ return argExtreme<true>(data, n); }
+template <typename T> size_t argMin(const T* data, size_t n){ return argExtreme<false>(data, n); }
+
+// ---------- TOP K ----------
+// A min heap of the k biggest seen so far. Most elements are smaller than
+// the smallest one in the heap, so the loop almost always just does one
+// compare that the branch predictor gets right
+
+template <typename T>
+vector <size_t> topK(const T* data, size_t n, size_t k){
+
+	typedef pair<T, size_t> Entry;
+	priority_queue <Entry, vector<Entry>, greater<Entry>> heap;
+
+	for(size_t i = 0; i < n; i++){
+		T x = data[i];
+		if(x != x) continue;
+		if(heap.size() < k) heap.push(Entry(x, i));
+		else if(x > heap.top().first){
+			heap.pop();
+			heap.push(Entry(x, i));
+		}
+	}
+
+	vector <size_t> result(heap.size());
+	for(size_t j = result.size(); j-- > 0; heap.pop()) result[j] = heap.top().second;
+	return result;
+
+}
+
+// ---------- MULTI THREADED ----------
+// Run func on numThreads slices and combine the slice results with merge
+
+template <typename Result, typename Func, typename Merge>
+Result parallelReduce(size_t n, unsigned numThreads, Func func, Merge merge){
+
+	vector <Result> results(numThreads);
+	vector <thread> workers;
+	size_t slice = (n + numThreads - 1) / numThreads;
+
+	for(unsigned t = 0; t < numThreads; t++){
+		size_t start = min(n, t * slice);
+		size_t end = min(n, start + slice);
+		workers.emplace_back([&, t, start, end]{ results[t] = func(start, end); });
+	}
+
+	for(thread& worker : workers) worker.join();
+
+	Result total = results[0];
+	for(unsigned t = 1; t < numThreads; t++) total = merge(total, results[t]);
+	return total;
+
+}
+
+template <typename T>
+Extremes<T> parallelExtremes(const T* data, size_t n, unsigned numThreads){
+
+	return parallelReduce<Extremes<T>>(n, numThreads,
+		[data](size_t start, size_t end){ return findExtremes(data + start, end - start); },
+		[](Extremes<T> a, Extremes<T> b){
+			return Extremes<T>{min(a.min, b.min), max(a.max, b.max), a.nanCount + b.nanCount};
+		});
+
+}
+
+template <typename T>
+size_t parallelArgMax(const T* data, size_t n, unsigned numThreads){
+
+	// Slices are combined in order so ties still go to the first index
+	return parallelReduce<size_t>(n, numThreads,
+		[data](size_t start, size_t end){
+			size_t found = argMax(data + start, end - start);
+			return found < end - start ? start + found : SIZE_MAX;
+		},
+		[data](size_t a, size_t b){
+			if(a == SIZE_MAX) return b;
+			if(b == SIZE_MAX) return a;
+			return data[b] > data[a] ? b : a;
+		});
+
+}
+
+// Time how long it takes to run a function in seconds
+template <typename Func>
+double timeIt(Func func){
+
+	auto start = chrono::steady_clock::now();
+	func();
+	chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count();
+
+}
+
+int main(int argc, char* argv[]){
+
+	// ---------- THE PART1 TERNARY ----------
+
+	int twoNums[2] = {5, 2};
+	cout << "The biggest number is " << twoNums[argMax(twoNums, 2)] << endl;
+
+	// ---------- HEIGHTS AND WEIGHTS ----------
+
+	size_t n = (argc > 1) ? atoll(argv[1]) : 100000000;
+	unsigned numThreads = thread::hardware_concurrency();
+	if(numThreads == 0) numThreads = 1;
+
+	Xoshiro256pp gen(2024);
+	vector <int32_t> heights(n);
+	vector <float> weights(n);
+
+	for(size_t i = 0; i < n; i++){
+		heights[i] = 20 + boundedRand(gen, 200);
+		weights[i] = 1.0f + boundedRand(gen, 100000) / 1000.0f;
+	}
+
+	// Plant some values so we know what the answers should be
+	heights[n / 3] = 500;
+	heights[n / 2] = 500;
+	weights[n / 4] = NAN;
+	weights[n / 5] = 0.5f;
+
+	Extremes<int32_t> h = findExtremes(heights.data(), n);
+	Extremes<float> w = findExtremes(weights.data(), n);
+
+	cout << "Heights from " << h.min << " to " << h.max << ", tallest at "
+		<< argMax(heights.data(), n) << " (expected " << n / 3 << ")" << endl;
+	cout << "Weights from " << w.min << " to " << w.max << " with " << w.nanCount
+		<< " NaN, lightest at " << argMin(weights.data(), n) << " (expected " << n / 5 << ")" << endl;
+
+	vector <size_t> top = topK(heights.data(), n, 5);
+	cout << "Top 5 heights :";
+	for(size_t index : top) cout << " " << heights[index];
+	cout << endl;
+
+	// ---------- SPEED ----------
+
+	double gigabytes = n * sizeof(int32_t) / 1e9;
+	size_t sink = 0;
+
+	double scalarTime = timeIt([&]{
+		Extremes<int32_t> r = {INT32_MAX, INT32_MIN, 0};
+		scalarExtremes(heights.data(), n, r);
+		sink += r.max;
+	});
+	double simdTime = timeIt([&]{ sink += findExtremes(heights.data(), n).max; });
+	double argTime = timeIt([&]{ sink += argMax(heights.data(), n); });
+	double floatTime = timeIt([&]{ sink += findExtremes(weights.data(), n).nanCount; });
+	double threadTime = timeIt([&]{ sink += parallelExtremes(heights.data(), n, numThreads).max; });
+	double threadArgTime = timeIt([&]{ sink += parallelArgMax(heights.data(), n, numThreads); });
+
+	cout << "int min/max scalar   " << gigabytes / scalarTime << " GB/s" << endl;
+	cout << "int min/max SIMD     " << gigabytes / simdTime << " GB/s" << endl;
+	cout << "int argmax SIMD      " << gigabytes / argTime << " GB/s" << endl;
+	cout << "float min/max SIMD   " << gigabytes / floatTime << " GB/s" << endl;
+	cout << "int min/max " << numThreads << " threads " << gigabytes / threadTime << " GB/s" << endl;
+	cout << "int argmax " << numThreads << " threads  " << gigabytes / threadArgTime << " GB/s" << endl;
+	cout << "Parallel argmax agrees " << (parallelArgMax(heights.data(), n, numThreads) == n / 3)
+		<< " (" << sink % 2 << ")" << endl;
+
+	return 0;
+}
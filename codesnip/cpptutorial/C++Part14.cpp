@@ -0,0 +1,409 @@
+#include <iostream>
+#include <vector>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include "Random.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// Checked Arithmetic
+// Part1 prints largestInt = 2147483647. Add 1 to it and an int silently
+// wraps around to -2147483648. addNumbers and getFactorial can do the same
+// GCC and Clang have __builtin_add_overflow and friends. They do the math
+// and tell us if the answer didn't fit, usually with a single jo
+// instruction after the add
+// Checked<T, Policy> picks what happens on overflow
+//
+// Wrap     : wrap around like unsigned math does, but on purpose
+// Saturate : stick at the largest or smallest value
+// Trap     : throw overflow_error
+//
+// For arrays, addAll<Policy> checks a whole block of adds at once, and
+// checkedAdd adds 8 ints at a time with AVX2 and sets a bit for every lane
+// that overflowed instead of stopping at the first one
+
+struct Wrap{
+	template <typename T>
+	static T onOverflow(T wrapped, bool){ return wrapped; }
+};
+
+struct Saturate{
+	// positive tells us which way the true answer went
+	template <typename T>
+	static T onOverflow(T, bool positive){
+		return positive ? numeric_limits<T>::max() : numeric_limits<T>::min();
+	}
+};
+
+struct Trap{
+	template <typename T>
+	static T onOverflow(T, bool){ throw overflow_error("integer overflow"); }
+};
+
+template <typename T, typename Policy = Trap>
+class Checked{
+
+	static_assert(is_integral<T>::value, "Checked only works with integers");
+
+	private:
+		T value;
+
+	public:
+		Checked(T value = 0) : value(value) {}
+
+		T get() const { return value; }
+
+		// explicit so a + 1 uses our checked + and not the one for ints
+		explicit operator T() const { return value; }
+
+		friend ostream& operator<<(ostream& os, Checked x){ return os << x.value; }
+
+		friend Checked operator+(Checked a, Checked b){
+			T result;
+			if(__builtin_expect(__builtin_add_overflow(a.value, b.value, &result), 0))
+				return Policy::onOverflow(result, b.value > 0);
+			return result;
+		}
+
+		friend Checked operator-(Checked a, Checked b){
+			T result;
+			if(__builtin_expect(__builtin_sub_overflow(a.value, b.value, &result), 0))
+				return Policy::onOverflow(result, b.value < 0);
+			return result;
+		}
+
+		friend Checked operator*(Checked a, Checked b){
+			T result;
+			if(__builtin_expect(__builtin_mul_overflow(a.value, b.value, &result), 0))
+				return Policy::onOverflow(result, (a.value < 0) == (b.value < 0));
+			return result;
+		}
+
+		Checked& operator+=(Checked other){ return *this = *this + other; }
+		Checked& operator-=(Checked other){ return *this = *this - other; }
+		Checked& operator*=(Checked other){ return *this = *this * other; }
+
+};
+
+// ---------- PART1 FUNCTIONS WITH CHECKS ----------
+
+template <typename Policy>
+Checked<int, Policy> addNumbers(Checked<int, Policy> firstNum, Checked<int, Policy> secondNum = 0){
+	return firstNum + secondNum;
+}
+
+template <typename Policy>
+Checked<int, Policy> getFactorial(int number){
+	if(number <= 1) return 1;
+	return getFactorial<Policy>(number - 1) * Checked<int, Policy>(number);
+}
+
+// ---------- ARRAYS ----------
+// Checking one add at a time puts a branch after every add, and that stops
+// the compiler from vectorizing the loop. addAll adds a block of 256 the
+// way plain ints do and ORs together a flag for every lane that didn't fit.
+// The OR has no branch so the block vectorizes. Only a block that
+// overflowed is added again one at a time so Policy can deal with it
+// With Trap, out already holds the sums before the bad lane when it throws
+// A sum overflows when both inputs have the same sign and the result has
+// the other one. (a ^ sum) & (b ^ sum) has its sign bit set exactly then
+
+// Adds n lanes wrapping and returns true if any of them overflowed
+// For signed lanes only the sign bit of bad matters, and it is looked at
+// once after the loop. With check false it is the same loop without the
+// test, which is what Wrap needs
+template <bool check, typename T>
+inline bool addWrapped(const T* a, const T* b, T* out, size_t n){
+
+	using U = make_unsigned_t<T>;
+
+	U bad = 0;
+	for(size_t i = 0; i < n; i++){
+		U sum = U(a[i]) + U(b[i]);
+		if(!check)
+			;
+		else if(is_signed<T>::value)
+			bad |= (U(a[i]) ^ sum) & (U(b[i]) ^ sum);
+		else
+			bad |= U(sum < U(a[i]));
+		out[i] = T(sum);
+	}
+	return is_signed<T>::value ? (bad >> (numeric_limits<U>::digits - 1)) != 0 : bad != 0;
+
+}
+
+// addAll<Wrap> never checks, so it is the unchecked loop in exactly the
+// same shape as the checked ones
+template <typename Policy, typename T>
+void addAll(const T* a, const T* b, T* out, size_t n){
+
+	const size_t block = 256;
+	const bool check = !is_same<Policy, Wrap>::value;
+
+	for(size_t start = 0; start < n; start += block){
+		// Full blocks pass block so the compiler knows the length
+		size_t length = (n - start < block) ? n - start : block;
+		bool bad = (length == block) ? addWrapped<check>(a + start, b + start, out + start, block)
+			: addWrapped<check>(a + start, b + start, out + start, length);
+		if(__builtin_expect(bad, 0))
+			for(size_t i = start; i < start + length; i++)
+				out[i] = (Checked<T, Policy>(a[i]) + b[i]).get();
+	}
+
+}
+
+// out[i] = a[i] + b[i] wrapping like normal ints, and bit i of overflowed
+// is set if that lane didn't fit. Returns how many lanes overflowed
+// With check false nothing is tested and overflowed isn't touched, so the
+// benchmark can time the same loop without the checks
+template <bool check>
+size_t addLanes(const int32_t* a, const int32_t* b, int32_t* out, size_t n,
+	uint64_t* overflowed){
+
+	size_t count = 0;
+	size_t i = 0;
+
+	if(check)
+		for(size_t w = 0; w < (n + 63) / 64; w++) overflowed[w] = 0;
+
+#ifdef __AVX2__
+	// The overflow lanes of a block are ORed together, so a block that fits
+	// costs one test. Only a block with an overflow works out its bits,
+	// again from the inputs and the sums it just stored
+	for(; i + 64 <= n; i += 64){
+		__m256i anyBad = _mm256_setzero_si256();
+		for(int j = 0; j < 64; j += 8){
+			__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i + j));
+			__m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i + j));
+			__m256i sum = _mm256_add_epi32(x, y);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + j), sum);
+			if(check)
+				anyBad = _mm256_or_si256(anyBad, _mm256_and_si256(_mm256_xor_si256(x, sum), _mm256_xor_si256(y, sum)));
+		}
+		if(check && __builtin_expect(_mm256_movemask_ps(_mm256_castsi256_ps(anyBad)) != 0, 0)){
+			uint64_t word = 0;
+			for(int j = 0; j < 64; j++)
+				word |= uint64_t((uint32_t(a[i + j]) ^ uint32_t(out[i + j])) & (uint32_t(b[i + j]) ^ uint32_t(out[i + j]))) >> 31 << j;
+			overflowed[i / 64] = word;
+			count += __builtin_popcountll(word);
+		}
+	}
+#endif
+
+	// Same test one lane at a time without a branch
+	for(; i < n; i++){
+		uint32_t sum = uint32_t(a[i]) + uint32_t(b[i]);
+		uint32_t bad = ((uint32_t(a[i]) ^ sum) & (uint32_t(b[i]) ^ sum)) >> 31;
+		out[i] = int32_t(sum);
+		if(!check) continue;
+		overflowed[i / 64] |= uint64_t(bad) << (i % 64);
+		count += bad;
+	}
+
+	return count;
+
+}
+
+size_t checkedAdd(const int32_t* a, const int32_t* b, int32_t* out, size_t n,
+	uint64_t* overflowed){
+	return addLanes<true>(a, b, out, n, overflowed);
+}
+
+// Time how long it takes to run a function in milliseconds
+template <typename Func>
+double timeIt(Func func){
+
+	auto start = chrono::steady_clock::now();
+	func();
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count();
+
+}
+
+// Tells the compiler memory may have been read, so it can't decide that
+// repeating the same loop is pointless and run it only once
+inline void clobberMemory(){ asm volatile("" : : : "memory"); }
+
+// The checked paths should cost less than this much more than the same
+// loop without the checks
+const double targetOverhead = 10;
+
+// Prints how much slower than its unchecked twin a checked path was and
+// whether that is inside the target
+void printCost(const char* name, double time, double plainTime){
+	double overhead = (time / plainTime - 1) * 100;
+	cout << "  " << name << time << " ms (" << overhead << "% vs unchecked, "
+		<< (overhead < targetOverhead ? "under" : "OVER") << " the "
+		<< targetOverhead << "% target)" << endl;
+}
+
+// Adds n pairs repeats times every way and prints how much longer the
+// checked versions take than unchecked loops of the same shape
+// addAll<Trap> and addAll<Saturate> are compared with addAll<Wrap>, and
+// checkedAdd with addLanes<false>. A plain out[i] = a[i] + b[i] loop
+// isn't used, since the compiler is free to vectorize it another way and
+// then we would be timing that and not the checks
+// Built with g++ -std=c++17 -O3 -march=native. At -O2 GCC vectorizes
+// neither shape of addAll, so the numbers are for scalar loops
+// One at a time is there to show what addAll saves and has no target
+void compareCosts(size_t n, int repeats){
+
+	Xoshiro256pp gen(2024);
+	vector <int32_t> a(n), b(n), out(n, 0);
+	vector <uint64_t> overflowed((n + 63) / 64);
+
+	// Small numbers so the trapping version doesn't throw
+	for(size_t i = 0; i < n; i++){
+		a[i] = boundedRand(gen, 1000000);
+		b[i] = boundedRand(gen, 1000000);
+	}
+
+	auto wrap = [&]{
+		for(int r = 0; r < repeats; r++){
+			addAll<Wrap>(a.data(), b.data(), out.data(), n);
+			clobberMemory();
+		}
+	};
+
+	auto oneAtATime = [&]{
+		for(int r = 0; r < repeats; r++){
+			for(size_t i = 0; i < n; i++) out[i] = (Checked<int32_t, Trap>(a[i]) + b[i]).get();
+			clobberMemory();
+		}
+	};
+
+	auto trap = [&]{
+		for(int r = 0; r < repeats; r++){
+			addAll<Trap>(a.data(), b.data(), out.data(), n);
+			clobberMemory();
+		}
+	};
+
+	auto saturate = [&]{
+		for(int r = 0; r < repeats; r++){
+			addAll<Saturate>(a.data(), b.data(), out.data(), n);
+			clobberMemory();
+		}
+	};
+
+	auto lanes = [&]{
+		for(int r = 0; r < repeats; r++){
+			addLanes<false>(a.data(), b.data(), out.data(), n, nullptr);
+			clobberMemory();
+		}
+	};
+
+	auto batch = [&]{
+		for(int r = 0; r < repeats; r++){
+			checkedAdd(a.data(), b.data(), out.data(), n, overflowed.data());
+			clobberMemory();
+		}
+	};
+
+	// Every round times each way once and we keep the best of 5, so a
+	// busy moment on the machine doesn't land on just one of them
+	double wrapTime = 1e300, oneTime = 1e300, trapTime = 1e300, saturateTime = 1e300;
+	double lanesTime = 1e300, batchTime = 1e300;
+	for(int round = 0; round < 5; round++){
+		wrapTime = min(wrapTime, timeIt(wrap));
+		oneTime = min(oneTime, timeIt(oneAtATime));
+		trapTime = min(trapTime, timeIt(trap));
+		saturateTime = min(saturateTime, timeIt(saturate));
+		lanesTime = min(lanesTime, timeIt(lanes));
+		batchTime = min(batchTime, timeIt(batch));
+	}
+
+	cout << "Adding " << n << " pairs " << repeats << " times" << endl;
+	cout << "  addAll Wrap         " << wrapTime << " ms" << endl;
+	cout << "  Trap one at a time  " << oneTime << " ms (" << (oneTime / wrapTime - 1) * 100 << "% vs addAll Wrap)" << endl;
+	printCost("addAll Trap         ", trapTime, wrapTime);
+	printCost("addAll Saturate     ", saturateTime, wrapTime);
+	cout << "  addLanes unchecked  " << lanesTime << " ms" << endl;
+	printCost("checkedAdd batch    ", batchTime, lanesTime);
+
+}
+
+int main(int argc, char* argv[]){
+
+	// ---------- THE LARGEST INT ----------
+
+	int largestInt = 2147483647;
+	cout << "Largest int " << largestInt << endl;
+
+	Checked<int, Wrap> wrapped = largestInt;
+	Checked<int, Saturate> saturated = largestInt;
+	Checked<int, Trap> trapped = largestInt;
+
+	cout << "Plus 1 wrapped    " << wrapped + 1 << endl;
+	cout << "Plus 1 saturated  " << saturated + 1 << endl;
+
+	try{
+		cout << "Plus 1 trapped    " << trapped + 1 << endl;
+	}
+	catch(overflow_error& e){
+		cout << e.what() << endl;
+	}
+
+	cout << "addNumbers(largestInt, 5) saturated " << addNumbers<Saturate>(largestInt, 5) << endl;
+
+	// 12! fits in an int, 13! doesn't
+	cout << "The factorial of 12 is " << getFactorial<Trap>(12) << endl;
+	cout << "The factorial of 13 saturated is " << getFactorial<Saturate>(13) << endl;
+
+	try{
+		getFactorial<Trap>(13);
+	}
+	catch(overflow_error& e){
+		cout << "The factorial of 13 " << e.what() << endl;
+	}
+
+	// ---------- COST OF CHECKING ----------
+	// Arrays that fit in cache show the cost of the checks themselves. The
+	// unchecked loops do one add per 8 lanes and the check adds an xor, an
+	// and and an or to that. In cache addAll goes over the target and the
+	// hand written AVX2 loop of checkedAdd lands close to it
+	// Big arrays are limited by memory speed, which hides most of the
+	// checks. addAll lands close to the target there and checkedAdd under
+	// it. Pass the big size on the command line
+
+	compareCosts(4096, 20000);
+
+	size_t n = (argc > 1) ? atoll(argv[1]) : 50000000;
+	compareCosts(n, 2);
+
+	vector <int32_t> a(n, 1), b(n, 1), out(n);
+	vector <uint64_t> overflowed((n + 63) / 64);
+
+	// Now make some lanes overflow and see that each one is reported
+	a[7] = numeric_limits<int32_t>::max();
+	a[n - 1] = numeric_limits<int32_t>::min();
+	b[n - 1] = -1;
+	size_t numOverflows = checkedAdd(a.data(), b.data(), out.data(), n, overflowed.data());
+
+	cout << "Lanes that overflowed " << numOverflows << " : ";
+	for(size_t w = 0; w < overflowed.size(); w++)
+		for(uint64_t bits = overflowed[w]; bits; bits &= bits - 1)
+			cout << w * 64 + __builtin_ctzll(bits) << " ";
+	cout << endl;
+
+	// addAll only looks closer at the blocks those lanes are in
+	addAll<Saturate>(a.data(), b.data(), out.data(), n);
+	cout << "Saturated lanes " << out[7] << " " << out[n - 1] << endl;
+
+	try{
+		addAll<Trap>(a.data(), b.data(), out.data(), n);
+	}
+	catch(overflow_error& e){
+		cout << "addAll<Trap> " << e.what() << endl;
+	}
+
+	return 0;
+}
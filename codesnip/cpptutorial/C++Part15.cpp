@@ -0,0 +1,242 @@
+#include <iostream>
+#include <vector>
+#include <stdexcept>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include "Random.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// Dividing by the Same Number Over and Over
+// Part1 does 5 / 2, 5 % 2 and rand() % 100. The compiler turns division by
+// a constant like 2 or 100 into a multiply and a shift, but when the
+// divisor is only known at run time it has to use the div instruction,
+// which takes 20 to 80 cycles and can't be done 8 at a time
+// Divider does the same trick as the compiler at run time. It works out a
+// magic number once when it is made and then every n / d is
+//
+//   t = high 32 bits of n * magic
+//   q = (t + ((n - t) >> shift1)) >> shift2
+//
+// That always works, for every divisor from 1 to 2^32 - 1, with no
+// branches, so the same steps run 8 at a time with AVX2
+// This is the round up method from Granlund and Montgomery's paper
+// "Division by Invariant Integers using Multiplication"
+
+class Divider{
+
+	private:
+		uint32_t divisor;
+		uint32_t magic;
+		uint32_t shift1;
+		uint32_t shift2;
+
+	public:
+		explicit Divider(uint32_t d) : divisor(d) {
+
+			if(d == 0) throw invalid_argument("Divider can't divide by 0");
+
+			// l is the smallest number with 2^l >= d
+			uint32_t l = (d == 1) ? 0 : 32 - __builtin_clz(d - 1);
+
+			// magic = 2^32 * (2^l - d) / d + 1 which always fits in 32 bits
+			uint64_t top = ((uint64_t(1) << l) - d) << 32;
+			magic = uint32_t(top / d + 1);
+			shift1 = (l > 0) ? 1 : 0;
+			shift2 = (l > 0) ? l - 1 : 0;
+
+		}
+
+		uint32_t value() const { return divisor; }
+
+		uint32_t divide(uint32_t n) const {
+			uint32_t t = uint32_t((uint64_t(n) * magic) >> 32);
+			return (t + ((n - t) >> shift1)) >> shift2;
+		}
+
+		uint32_t remainder(uint32_t n) const { return n - divide(n) * divisor; }
+
+		friend uint32_t operator/(uint32_t n, const Divider& d){ return d.divide(n); }
+		friend uint32_t operator%(uint32_t n, const Divider& d){ return d.remainder(n); }
+
+#ifdef __AVX2__
+		// The same steps on 8 numbers. AVX2 can only multiply the even
+		// 32 bit lanes into 64 bit answers, so the odd lanes are shifted
+		// down, multiplied separately and blended back in
+		__m256i divide(__m256i n) const {
+
+			const __m256i m = _mm256_set1_epi32(magic);
+			__m256i hiEven = _mm256_srli_epi64(_mm256_mul_epu32(n, m), 32);
+			__m256i hiOdd = _mm256_mul_epu32(_mm256_srli_epi64(n, 32), m);
+			__m256i t = _mm256_blend_epi32(hiEven, hiOdd, 0xAA);
+
+			__m256i q = _mm256_srl_epi32(_mm256_sub_epi32(n, t), _mm_cvtsi32_si128(shift1));
+			return _mm256_srl_epi32(_mm256_add_epi32(t, q), _mm_cvtsi32_si128(shift2));
+
+		}
+
+		__m256i remainder(__m256i n) const {
+			__m256i q = divide(n);
+			return _mm256_sub_epi32(n, _mm256_mullo_epi32(q, _mm256_set1_epi32(divisor)));
+		}
+#endif
+
+};
+
+// ---------- WHOLE ARRAYS ----------
+
+// out[i] = in[i] / d
+void divideAll(const uint32_t* in, uint32_t* out, size_t n, const Divider& d){
+
+	size_t i = 0;
+
+#ifdef __AVX2__
+	for(; i + 8 <= n; i += 8){
+		__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), d.divide(x));
+	}
+#endif
+
+	for(; i < n; i++) out[i] = in[i] / d;
+
+}
+
+// out[i] = in[i] % d
+void remainderAll(const uint32_t* in, uint32_t* out, size_t n, const Divider& d){
+
+	size_t i = 0;
+
+#ifdef __AVX2__
+	for(; i + 8 <= n; i += 8){
+		__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), d.remainder(x));
+	}
+#endif
+
+	for(; i < n; i++) out[i] = in[i] % d;
+
+}
+
+// ---------- BUCKETING ----------
+// Counts how many values land in each bucket of the given width. The
+// divisions are done a block at a time into a small buffer that stays in
+// cache, then the counts are added up from the buffer
+
+void bucketCounts(const uint32_t* values, size_t n, const Divider& width,
+	vector <uint64_t>& counts){
+
+	const size_t block = 1024;
+	uint32_t buckets[block];
+
+	for(size_t i = 0; i < n; i += block){
+		size_t len = min(block, n - i);
+		divideAll(values + i, buckets, len, width);
+		for(size_t j = 0; j < len; j++) counts[buckets[j]]++;
+	}
+
+}
+
+// Time how long it takes to run a function in milliseconds
+template <typename Func>
+double timeIt(Func func){
+
+	auto start = chrono::steady_clock::now();
+	func();
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count();
+
+}
+
+int main(int argc, char* argv[]){
+
+	// ---------- THE PART1 EXAMPLES ----------
+
+	Divider two(2);
+	cout << "5 / 2 = " << 5 / two << endl;
+	cout << "5 % 2 = " << 5 % two << endl;
+
+	// A random number from 1 to 100 like Part1, without the div instruction
+	Xoshiro256pp gen(2024);
+	Divider hundred(100);
+	cout << "Random number " << (uint32_t(gen()) % hundred) + 1 << endl;
+
+	try{
+		Divider zero(0);
+	}
+	catch(invalid_argument& e){
+		cout << e.what() << endl;
+	}
+
+	// Check the magic numbers against real division for lots of divisors,
+	// including every power of 2 and the biggest ones
+	vector <uint32_t> divisors = {1, 3, 7, 10, 100, 641, 1000000007u,
+		0x7FFFFFFFu, 0x80000001u, 0xFFFFFFFEu, 0xFFFFFFFFu};
+	for(int b = 0; b < 32; b++) divisors.push_back(1u << b);
+	for(int i = 0; i < 200; i++) divisors.push_back(uint32_t(gen()) | 1);
+
+	vector <uint32_t> tests = {0, 1, 2, 99, 100, 101, 0x7FFFFFFFu, 0x80000000u,
+		0xFFFFFFFEu, 0xFFFFFFFFu};
+	for(int i = 0; i < 1000; i++) tests.push_back(uint32_t(gen()));
+
+	vector <uint32_t> got(tests.size());
+	size_t wrong = 0;
+	for(uint32_t d : divisors){
+		Divider div(d);
+		divideAll(tests.data(), got.data(), tests.size(), div);
+		for(size_t i = 0; i < tests.size(); i++) wrong += (got[i] != tests[i] / d);
+		remainderAll(tests.data(), got.data(), tests.size(), div);
+		for(size_t i = 0; i < tests.size(); i++) wrong += (got[i] != tests[i] % d);
+	}
+	cout << "Checked " << divisors.size() << " divisors, " << wrong << " wrong answers" << endl;
+
+	// ---------- SPEED ----------
+	// The bucket width comes from the command line so the compiler can't
+	// turn the plain loop into a multiply itself
+
+	size_t n = (argc > 1) ? atoll(argv[1]) : 50000000;
+	uint32_t width = (argc > 2) ? atoi(argv[2]) : 100000;
+
+	vector <uint32_t> values(n), out(n);
+	for(size_t i = 0; i < n; i++) values[i] = uint32_t(gen());
+
+	Divider widthDiv(width);
+
+	double plainDiv = timeIt([&]{ for(size_t i = 0; i < n; i++) out[i] = values[i] / width; });
+	double magicDiv = timeIt([&]{ divideAll(values.data(), out.data(), n, widthDiv); });
+
+	double plainMod = timeIt([&]{ for(size_t i = 0; i < n; i++) out[i] = values[i] % width; });
+	double magicMod = timeIt([&]{ remainderAll(values.data(), out.data(), n, widthDiv); });
+
+	cout << "Dividing " << n << " numbers by " << width << endl;
+	cout << "  /  div instruction " << plainDiv << " ms, Divider " << magicDiv << " ms ("
+		<< plainDiv / magicDiv << "x faster)" << endl;
+	cout << "  %  div instruction " << plainMod << " ms, Divider " << magicMod << " ms ("
+		<< plainMod / magicMod << "x faster)" << endl;
+
+	// Bucketing the values into buckets of the given width. Tiny widths
+	// would need billions of counters so they stop here
+	size_t numBuckets = 0xFFFFFFFFu / width + 1;
+	if(numBuckets > (1u << 24)){
+		cout << "  width too small for bucketing" << endl;
+		return 0;
+	}
+
+	vector <uint64_t> plainCounts(numBuckets, 0), magicCounts(numBuckets, 0);
+
+	double plainBuckets = timeIt([&]{
+		for(size_t i = 0; i < n; i++) plainCounts[values[i] / width]++;
+	});
+	double magicBuckets = timeIt([&]{
+		bucketCounts(values.data(), n, widthDiv, magicCounts);
+	});
+
+	cout << "  bucketing div instruction " << plainBuckets << " ms, Divider " << magicBuckets
+		<< " ms, same counts " << boolalpha << (plainCounts == magicCounts) << endl;
+
+	return 0;
+}
@@ -0,0 +1,328 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <new>
+#include <utility>
+#include <stdexcept>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include "Random.h"
+
+using namespace std;
+
+// Errors Without Exceptions
+// Part1 throws an int when we try to divide by 0, and stoi and stod throw
+// when the text isn't a number. Throwing is fine when it almost never
+// happens, but each throw costs a trip through the unwinder that is
+// thousands of times slower than a return. When bad input is common that
+// cost swamps everything else
+// Expected<T, E> holds either a value or an error. Functions return it
+// instead of throwing and the caller checks it like a bool
+//
+// Expected<int, Errc> result = parseInt("42");
+// if(result) cout << *result;
+// else cout << errorName(result.error());
+//
+// It is [[nodiscard]] so the compiler warns if a result is ignored
+
+enum class Errc{
+	DivideByZero,
+	NotANumber,
+	OutOfRange,
+	ExtraCharacters
+};
+
+const char* errorName(Errc e){
+	switch(e){
+		case Errc::DivideByZero: return "divide by zero";
+		case Errc::NotANumber: return "not a number";
+		case Errc::OutOfRange: return "out of range";
+		case Errc::ExtraCharacters: return "extra characters after the number";
+	}
+	return "unknown error";
+}
+
+// Wraps an error so Expected<int, int> knows which one we mean
+template <typename E>
+struct Unexpected{
+	E error;
+};
+
+template <typename E>
+Unexpected<E> unexpected(E error){ return Unexpected<E>{error}; }
+
+template <typename T, typename E>
+class [[nodiscard]] Expected{
+
+	private:
+		// Only one of these is alive at a time and ok says which
+		union{
+			T val;
+			E err;
+		};
+		bool ok;
+
+		void destroy(){
+			if(ok) val.~T();
+			else err.~E();
+		}
+
+		void copyFrom(const Expected& other){
+			if(other.ok) new (&val) T(other.val);
+			else new (&err) E(other.err);
+			ok = other.ok;
+		}
+
+		void moveFrom(Expected&& other){
+			if(other.ok) new (&val) T(move(other.val));
+			else new (&err) E(move(other.err));
+			ok = other.ok;
+		}
+
+	public:
+		Expected(const T& value) : val(value), ok(true) {}
+		Expected(T&& value) : val(move(value)), ok(true) {}
+		Expected(Unexpected<E> e) : err(move(e.error)), ok(false) {}
+
+		Expected(const Expected& other){ copyFrom(other); }
+		Expected(Expected&& other){ moveFrom(move(other)); }
+
+		Expected& operator=(const Expected& other){
+			if(this != &other){ destroy(); copyFrom(other); }
+			return *this;
+		}
+
+		Expected& operator=(Expected&& other){
+			if(this != &other){ destroy(); moveFrom(move(other)); }
+			return *this;
+		}
+
+		~Expected(){ destroy(); }
+
+		bool hasValue() const { return ok; }
+		explicit operator bool() const { return ok; }
+
+		// Asking for a value that isn't there is a bug in the caller, not
+		// bad input, so that one still throws
+		T& value(){
+			if(!ok) throw logic_error("Expected holds an error, not a value");
+			return val;
+		}
+
+		const T& value() const {
+			if(!ok) throw logic_error("Expected holds an error, not a value");
+			return val;
+		}
+
+		T& operator*(){ return val; }
+		const T& operator*() const { return val; }
+		T* operator->(){ return &val; }
+		const T* operator->() const { return &val; }
+
+		const E& error() const { return err; }
+
+		T valueOr(T other) const { return ok ? val : other; }
+
+		// Runs func on the value if there is one and passes errors along
+		// so several steps can be chained without checking each one
+		template <typename Func>
+		auto andThen(Func func) const -> decltype(func(val)) {
+			if(ok) return func(val);
+			return unexpected(err);
+		}
+
+};
+
+// ---------- CHECKED OPERATIONS ----------
+
+Expected<int, Errc> checkedDivide(int numerator, int denominator){
+	if(denominator == 0) return unexpected(Errc::DivideByZero);
+	// The answer would be one more than the largest int, and the divide
+	// instruction crashes instead of wrapping
+	if(numerator == numeric_limits<int>::min() && denominator == -1) return unexpected(Errc::OutOfRange);
+	return numerator / denominator;
+}
+
+// Like stoi, but the whole string has to be the number. stoi("12abc") is 12
+// while parseInt("12abc") is an error
+Expected<int, Errc> parseInt(const string& text){
+
+	int result = 0;
+	const char* first = text.data();
+	const char* last = first + text.size();
+
+	// from_chars doesn't skip a leading + like stoi does. A second sign
+	// after it, as in "+-5", is not a number
+	if(first != last && *first == '+'){
+		first++;
+		if(first != last && (*first == '-' || *first == '+')) return unexpected(Errc::NotANumber);
+	}
+
+	auto [end, ec] = from_chars(first, last, result);
+	if(ec == errc::invalid_argument) return unexpected(Errc::NotANumber);
+	if(ec == errc::result_out_of_range) return unexpected(Errc::OutOfRange);
+	if(end != last) return unexpected(Errc::ExtraCharacters);
+	return result;
+
+}
+
+Expected<double, Errc> parseDouble(const string& text){
+
+	double result = 0;
+	const char* first = text.data();
+	const char* last = first + text.size();
+
+	if(first != last && *first == '+'){
+		first++;
+		if(first != last && (*first == '-' || *first == '+')) return unexpected(Errc::NotANumber);
+	}
+
+	auto [end, ec] = from_chars(first, last, result);
+	if(ec == errc::invalid_argument) return unexpected(Errc::NotANumber);
+	if(ec == errc::result_out_of_range) return unexpected(Errc::OutOfRange);
+	if(end != last) return unexpected(Errc::ExtraCharacters);
+	return result;
+
+}
+
+// The Part1 way, throwing the bad number
+int throwingDivide(int numerator, int denominator){
+	if(denominator == 0) throw(denominator);
+	return numerator / denominator;
+}
+
+// Time how long it takes to run a function in milliseconds
+template <typename Func>
+double timeIt(Func func){
+
+	auto start = chrono::steady_clock::now();
+	func();
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count();
+
+}
+
+// Makes n inputs where about errorPercent of them are bad, then parses and
+// divides them both ways and prints the times
+void compareCosts(size_t n, int errorPercent){
+
+	Xoshiro256pp gen(2024 + errorPercent);
+	vector <string> texts(n);
+	vector <int> denominators(n);
+
+	for(size_t i = 0; i < n; i++){
+		bool bad = boundedRand(gen, 100) < uint32_t(errorPercent);
+		texts[i] = bad ? "abc" : to_string(boundedRand(gen, 1000000));
+		denominators[i] = bad ? 0 : 1 + boundedRand(gen, 100);
+	}
+
+	long long sum = 0;
+	size_t numBad = 0;
+
+	double stoiTime = timeIt([&]{
+		for(size_t i = 0; i < n; i++){
+			try{
+				sum += stoi(texts[i]);
+			}
+			catch(invalid_argument&){
+				numBad++;
+			}
+		}
+	});
+
+	double parseTime = timeIt([&]{
+		for(size_t i = 0; i < n; i++){
+			Expected<int, Errc> number = parseInt(texts[i]);
+			if(number) sum += *number;
+			else numBad++;
+		}
+	});
+
+	double throwTime = timeIt([&]{
+		for(size_t i = 0; i < n; i++){
+			try{
+				sum += throwingDivide(1000000, denominators[i]);
+			}
+			catch(int){
+				numBad++;
+			}
+		}
+	});
+
+	double expectedTime = timeIt([&]{
+		for(size_t i = 0; i < n; i++){
+			Expected<int, Errc> quotient = checkedDivide(1000000, denominators[i]);
+			if(quotient) sum += *quotient;
+			else numBad++;
+		}
+	});
+
+	cout << errorPercent << "% bad, " << n << " inputs (" << numBad / 4 << " bad each way, sum "
+		<< sum << ")" << endl;
+	cout << "  parse  stoi + catch " << stoiTime << " ms, parseInt " << parseTime << " ms ("
+		<< stoiTime / parseTime << "x)" << endl;
+	cout << "  divide throw + catch " << throwTime << " ms, checkedDivide " << expectedTime << " ms ("
+		<< throwTime / expectedTime << "x)" << endl;
+
+}
+
+int main(int argc, char* argv[]){
+
+	// ---------- THE PART1 EXAMPLE ----------
+
+	int number = 0;
+
+	Expected<int, Errc> quotient = checkedDivide(2, number);
+	if(quotient) cout << *quotient << endl;
+	else cout << number << " is not valid input: " << errorName(quotient.error()) << endl;
+
+	cout << "10 / 3 = " << checkedDivide(10, 3).valueOr(0) << endl;
+
+	// The one division of two ints whose answer doesn't fit
+	cout << "smallest int / -1 " << errorName(checkedDivide(numeric_limits<int>::min(), -1).error()) << endl;
+
+	// ---------- PARSING ----------
+
+	for(string text : {"42", "+7", "-13", "+-5", "abc", "12abc", "99999999999"}){
+		Expected<int, Errc> parsed = parseInt(text);
+		cout << "parseInt(\"" << text << "\") ";
+		if(parsed) cout << "= " << *parsed << endl;
+		else cout << "failed: " << errorName(parsed.error()) << endl;
+	}
+
+	Expected<double, Errc> euler = parseDouble("2.718");
+	cout << "parseDouble(\"2.718\") = " << euler.valueOr(0) << endl;
+
+	// Parse two numbers and divide them, stopping at the first error
+	auto divideText = [](const string& top, const string& bottom){
+		return parseInt(top).andThen([&](int a){
+			return parseInt(bottom).andThen([&](int b){ return checkedDivide(a, b); });
+		});
+	};
+
+	Expected<int, Errc> good = divideText("100", "7");
+	Expected<int, Errc> bad = divideText("100", "0");
+	cout << "\"100\" / \"7\" = " << good.valueOr(-1) << ", \"100\" / \"0\" "
+		<< errorName(bad.error()) << endl;
+
+	try{
+		cout << bad.value() << endl;
+	}
+	catch(logic_error& e){
+		cout << e.what() << endl;
+	}
+
+	// ---------- THROW VS EXPECTED ----------
+	// Pass the number of inputs on the command line
+
+	size_t n = (argc > 1) ? atoll(argv[1]) : 2000000;
+
+	compareCosts(n, 0);
+	compareCosts(n, 1);
+	compareCosts(n, 50);
+
+	return 0;
+}
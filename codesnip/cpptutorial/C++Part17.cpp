@@ -0,0 +1,272 @@
+#include <iostream>
+#include <vector>
+#include <iterator>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include "Random.h"
+
+using namespace std;
+
+// Strided Spans
+// Part1 walks badNums with numArrayPtr++, which moves one int at a time
+// Lots of number crunching walks every 4th or every 16th element instead,
+// like one field out of an array of structs or one column of a matrix
+// StridedSpan<T, Stride> is a pointer, a length and a step size
+//
+// StridedSpan<int> any(nums, 100, 4)   step picked at run time
+// StridedSpan<int, 4> four(nums, 100)  step known when compiling
+//
+// When the step is known when compiling it takes no space and the compiler
+// can unroll and vectorize with it. A negative step walks backwards
+//
+// span[i] checks i against the size only in debug builds. Build with
+// -DNDEBUG and it is as cheap as a raw pointer. at(i) always checks
+//
+// gather() visits elements in the order a list of indexes gives. Those
+// jump all over memory so every one is a cache miss. gather asks the CPU
+// to start loading the element distance steps ahead while it works on
+// this one, so the misses overlap instead of waiting one after another
+
+constexpr ptrdiff_t dynamicStride = 0;
+
+// Holds the step. The compile time version is empty
+template <ptrdiff_t Stride>
+struct StrideHolder{
+	StrideHolder(ptrdiff_t){}
+	static constexpr ptrdiff_t stride(){ return Stride; }
+};
+
+template <>
+struct StrideHolder<dynamicStride>{
+	ptrdiff_t step;
+	StrideHolder(ptrdiff_t step) : step(step) {}
+	ptrdiff_t stride() const { return step; }
+};
+
+template <typename T, ptrdiff_t Stride = dynamicStride>
+class StridedSpan : private StrideHolder<Stride>{
+
+	private:
+		T* first;
+		size_t length;
+
+	public:
+		using StrideHolder<Stride>::stride;
+
+		class Iterator : private StrideHolder<Stride>{
+
+			private:
+				T* first;
+				ptrdiff_t i;
+
+			public:
+				using iterator_category = random_access_iterator_tag;
+				using value_type = typename remove_const<T>::type;
+				using difference_type = ptrdiff_t;
+				using pointer = T*;
+				using reference = T&;
+
+				Iterator(T* first, ptrdiff_t i, ptrdiff_t step)
+					: StrideHolder<Stride>(step), first(first), i(i) {}
+
+				T& operator*() const { return first[i * this -> stride()]; }
+				T& operator[](ptrdiff_t k) const { return first[(i + k) * this -> stride()]; }
+
+				Iterator& operator++(){ i++; return *this; }
+				Iterator operator++(int){ Iterator old = *this; i++; return old; }
+				Iterator& operator--(){ i--; return *this; }
+				Iterator operator--(int){ Iterator old = *this; i--; return old; }
+				Iterator& operator+=(ptrdiff_t k){ i += k; return *this; }
+				Iterator& operator-=(ptrdiff_t k){ i -= k; return *this; }
+
+				friend Iterator operator+(Iterator it, ptrdiff_t k){ return it += k; }
+				friend Iterator operator+(ptrdiff_t k, Iterator it){ return it += k; }
+				friend Iterator operator-(Iterator it, ptrdiff_t k){ return it -= k; }
+				friend ptrdiff_t operator-(const Iterator& a, const Iterator& b){ return a.i - b.i; }
+
+				friend bool operator==(const Iterator& a, const Iterator& b){ return a.i == b.i; }
+				friend bool operator!=(const Iterator& a, const Iterator& b){ return a.i != b.i; }
+				friend bool operator<(const Iterator& a, const Iterator& b){ return a.i < b.i; }
+				friend bool operator>(const Iterator& a, const Iterator& b){ return a.i > b.i; }
+				friend bool operator<=(const Iterator& a, const Iterator& b){ return a.i <= b.i; }
+				friend bool operator>=(const Iterator& a, const Iterator& b){ return a.i >= b.i; }
+
+		};
+
+		// first points at element 0. With a negative step it is the last
+		// one in memory
+		StridedSpan(T* first, size_t length, ptrdiff_t step = Stride)
+			: StrideHolder<Stride>(step), first(first), length(length) {
+			if(stride() == 0) throw invalid_argument("StridedSpan needs a step that isn't 0");
+		}
+
+		size_t size() const { return length; }
+		bool empty() const { return length == 0; }
+
+		T& operator[](size_t i) const {
+#ifndef NDEBUG
+			if(i >= length) throw out_of_range("StridedSpan index " + to_string(i) +
+				" but size is " + to_string(length));
+#endif
+			return first[ptrdiff_t(i) * stride()];
+		}
+
+		T& at(size_t i) const {
+			if(i >= length) throw out_of_range("StridedSpan index " + to_string(i) +
+				" but size is " + to_string(length));
+			return first[ptrdiff_t(i) * stride()];
+		}
+
+		Iterator begin() const { return Iterator(first, 0, stride()); }
+		Iterator end() const { return Iterator(first, length, stride()); }
+
+		// Every count'th element starting at offset, still a strided span
+		StridedSpan<T> every(size_t count, size_t offset = 0) const {
+			size_t remaining = (offset < length) ? length - offset : 0;
+			return StridedSpan<T>(first + ptrdiff_t(offset) * stride(),
+				(remaining + count - 1) / count, stride() * ptrdiff_t(count));
+		}
+
+		// Calls func(span[indexes[k]]) for every k. The element distance
+		// steps ahead is prefetched so its cache miss overlaps this one
+		// The indexes are trusted like operator[] in a release build
+		template <size_t Distance = 16, typename Index, typename Func>
+		void gather(const Index* indexes, size_t n, Func func) const {
+
+			size_t k = 0;
+
+			for(; k + Distance < n; k++){
+				__builtin_prefetch(&first[ptrdiff_t(indexes[k + Distance]) * stride()]);
+				func((*this)[indexes[k]]);
+			}
+
+			for(; k < n; k++) func((*this)[indexes[k]]);
+
+		}
+
+};
+
+// Time how long it takes to run a function in milliseconds
+template <typename Func>
+double timeIt(Func func){
+
+	auto start = chrono::steady_clock::now();
+	func();
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count();
+
+}
+
+// Stands in for the work a real loop does with each element
+uint64_t scramble(uint64_t x){
+
+	for(int round = 0; round < 4; round++){
+		x ^= x >> 31;
+		x *= 0x9E3779B97F4A7C15ULL;
+	}
+	return x;
+
+}
+
+int main(int argc, char* argv[]){
+
+	// ---------- THE BADNUMS EXAMPLE ----------
+
+	int badNums[5] = {4, 13, 14, 24, 34};
+
+	StridedSpan<int, 1> nums(badNums, 5);
+	for(int num : nums) cout << num << " ";
+	cout << endl;
+
+	// Every other one and then backwards from the end
+	StridedSpan<int, 2> everyOther(badNums, 3);
+	StridedSpan<int, -1> backwards(badNums + 4, 5);
+	for(int num : everyOther) cout << num << " ";
+	cout << "| ";
+	for(int num : backwards) cout << num << " ";
+	cout << endl;
+
+	cout << "Sum " << accumulate(nums.begin(), nums.end(), 0) << ", compile time stride takes "
+		<< sizeof(everyOther) << " bytes and run time stride "
+		<< sizeof(StridedSpan<int>(badNums, 5, 1)) << " bytes" << endl;
+
+	try{
+		nums.at(5);
+	}
+	catch(out_of_range& e){
+		cout << e.what() << endl;
+	}
+
+	// ---------- ONE FIELD OUT OF MANY ----------
+	// Records of 4 ints, summing just the second field of each
+
+	size_t n = (argc > 1) ? atoll(argv[1]) : 16000000;
+	Xoshiro256pp gen(2024);
+
+	vector <int> records(n * 4);
+	for(int& value : records) value = boundedRand(gen, 100);
+
+	long long rawSum = 0, fixedSum = 0, dynamicSum = 0;
+
+	double raw = timeIt([&]{
+		for(const int* p = records.data() + 1; p < records.data() + n * 4; p += 4) rawSum += *p;
+	});
+
+	StridedSpan<const int, 4> fixedField(records.data() + 1, n);
+	double fixed = timeIt([&]{
+		for(size_t i = 0; i < fixedField.size(); i++) fixedSum += fixedField[i];
+	});
+
+	StridedSpan<const int> dynamicField(records.data() + 1, n, 4);
+	double dynamic = timeIt([&]{
+		for(int value : dynamicField) dynamicSum += value;
+	});
+
+	cout << "Field sum of " << n << " records" << endl;
+	cout << "  pointer += 4      " << raw << " ms" << endl;
+	cout << "  StridedSpan<4>    " << fixed << " ms" << endl;
+	cout << "  StridedSpan(4)    " << dynamic << " ms, same sums "
+		<< boolalpha << (rawSum == fixedSum && rawSum == dynamicSum) << endl;
+
+	// ---------- GATHERS ----------
+	// Random indexes into the records, so nearly every read misses the
+	// cache. With an empty loop body the CPU already runs ahead and
+	// overlaps the misses by itself, so prefetching only pays off when
+	// each element gets some real work, like scramble here
+
+	vector <uint32_t> indexes(n);
+	for(uint32_t& index : indexes) index = boundedRand(gen, n);
+
+	cout << "Gather of " << n << " random records" << endl;
+
+	for(bool withWork : {false, true}){
+
+		unsigned long long plainGather = 0, prefetchGather = 0;
+
+		double plain = timeIt([&]{
+			for(size_t k = 0; k < n; k++){
+				int value = fixedField[indexes[k]];
+				plainGather += withWork ? scramble(value) : value;
+			}
+		});
+
+		double prefetched = timeIt([&]{
+			fixedField.gather(indexes.data(), n, [&](int value){
+				prefetchGather += withWork ? scramble(value) : value;
+			});
+		});
+
+		cout << (withWork ? "  with work" : "  just sums") << "  plain loop " << plain
+			<< " ms, prefetching " << prefetched << " ms, same sums "
+			<< (plainGather == prefetchGather) << endl;
+
+	}
+
+	return 0;
+}
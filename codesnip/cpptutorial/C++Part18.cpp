@@ -0,0 +1,274 @@
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include "Random.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// Changing Millions of Values at Once
+// makeMeYoung(int* age) and actYourAge(int& age) in Part1 change one age
+// through a pointer or a reference. Here we change whole columns of ages,
+// heights and weights in place with rules like "every age above 50 becomes
+// 50" or "add 2 to every height"
+//
+// updateWhere(keys, values, n, condition, change) does
+//
+//   if(condition(keys[i])) values[i] = change(values[i])
+//
+// and returns how many values really changed. keys and values can be the
+// same column or two different ones
+//
+// With AVX2, 8 values are tested at once and a masked store writes only
+// the lanes that changed. There is no branch on whether a group of 8 has
+// changes. Which groups do is random, so that branch would be guessed
+// wrong often enough to make the kernel twice as slow
+// parallelUpdate splits the column into chunks and threads take chunks
+// until none are left. It returns the change count of every chunk
+
+// ---------- CONDITIONS ----------
+// Each one has a scalar test and an 8 lane test that returns all 1 bits
+// in the lanes that pass
+
+struct Always{
+	bool test(int) const { return true; }
+#ifdef __AVX2__
+	__m256i test(__m256i) const { return _mm256_set1_epi32(-1); }
+#endif
+};
+
+struct Above{
+	int limit;
+	bool test(int x) const { return x > limit; }
+#ifdef __AVX2__
+	__m256i test(__m256i x) const { return _mm256_cmpgt_epi32(x, _mm256_set1_epi32(limit)); }
+#endif
+};
+
+struct Below{
+	int limit;
+	bool test(int x) const { return x < limit; }
+#ifdef __AVX2__
+	__m256i test(__m256i x) const { return _mm256_cmpgt_epi32(_mm256_set1_epi32(limit), x); }
+#endif
+};
+
+// low <= x <= high
+struct Between{
+	int low;
+	int high;
+	bool test(int x) const { return x >= low && x <= high; }
+#ifdef __AVX2__
+	__m256i test(__m256i x) const {
+		__m256i tooLow = _mm256_cmpgt_epi32(_mm256_set1_epi32(low), x);
+		__m256i tooHigh = _mm256_cmpgt_epi32(x, _mm256_set1_epi32(high));
+		return _mm256_xor_si256(_mm256_or_si256(tooLow, tooHigh), _mm256_set1_epi32(-1));
+	}
+#endif
+};
+
+// ---------- CHANGES ----------
+
+struct SetTo{
+	int value;
+	int apply(int) const { return value; }
+#ifdef __AVX2__
+	__m256i apply(__m256i) const { return _mm256_set1_epi32(value); }
+#endif
+};
+
+struct AddDelta{
+	int delta;
+	int apply(int x) const { return x + delta; }
+#ifdef __AVX2__
+	__m256i apply(__m256i x) const { return _mm256_add_epi32(x, _mm256_set1_epi32(delta)); }
+#endif
+};
+
+// Keeps x between low and high
+struct ClampTo{
+	int low;
+	int high;
+	int apply(int x) const { return min(max(x, low), high); }
+#ifdef __AVX2__
+	__m256i apply(__m256i x) const {
+		return _mm256_min_epi32(_mm256_max_epi32(x, _mm256_set1_epi32(low)), _mm256_set1_epi32(high));
+	}
+#endif
+};
+
+// ---------- THE KERNEL ----------
+
+template <typename Condition, typename Change>
+size_t updateWhere(const int* keys, int* values, size_t n, Condition condition, Change change){
+
+	size_t numChanged = 0;
+	size_t i = 0;
+
+#ifdef __AVX2__
+	for(; i + 8 <= n; i += 8){
+		__m256i key = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+		__m256i old = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+		__m256i updated = change.apply(old);
+
+		// Lanes that pass the test and end up with a different value
+		__m256i differs = _mm256_xor_si256(_mm256_cmpeq_epi32(updated, old), _mm256_set1_epi32(-1));
+		__m256i write = _mm256_and_si256(condition.test(key), differs);
+
+		unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(write));
+		_mm256_maskstore_epi32(values + i, write, updated);
+		numChanged += __builtin_popcount(mask);
+	}
+#endif
+
+	for(; i < n; i++){
+		if(!condition.test(keys[i])) continue;
+		int updated = change.apply(values[i]);
+		if(updated != values[i]){
+			values[i] = updated;
+			numChanged++;
+		}
+	}
+
+	return numChanged;
+
+}
+
+// The condition looks at the same column it changes
+template <typename Condition, typename Change>
+size_t updateWhere(int* values, size_t n, Condition condition, Change change){
+	return updateWhere(values, values, n, condition, change);
+}
+
+// Runs updateWhere over chunks of chunkSize values on numThreads threads
+// chunkCounts gets one entry per chunk no matter which thread ran it
+template <typename Condition, typename Change>
+size_t parallelUpdate(const int* keys, int* values, size_t n, Condition condition, Change change,
+	unsigned numThreads, vector <size_t>& chunkCounts, size_t chunkSize = 1 << 20){
+
+	size_t numChunks = (n + chunkSize - 1) / chunkSize;
+	chunkCounts.assign(numChunks, 0);
+	atomic <size_t> nextChunk(0);
+
+	auto worker = [&]{
+		for(size_t chunk = nextChunk++; chunk < numChunks; chunk = nextChunk++){
+			size_t start = chunk * chunkSize;
+			size_t len = min(chunkSize, n - start);
+			chunkCounts[chunk] = updateWhere(keys + start, values + start, len, condition, change);
+		}
+	};
+
+	vector <thread> workers;
+	for(unsigned t = 1; t < numThreads; t++) workers.emplace_back(worker);
+	worker();
+	for(thread& w : workers) w.join();
+
+	size_t total = 0;
+	for(size_t count : chunkCounts) total += count;
+	return total;
+
+}
+
+// Time how long it takes to run a function in milliseconds
+template <typename Func>
+double timeIt(Func func){
+
+	auto start = chrono::steady_clock::now();
+	func();
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count();
+
+}
+
+int main(int argc, char* argv[]){
+
+	// ---------- THE PART1 EXAMPLES ----------
+	// makeMeYoung and actYourAge on a whole column
+
+	vector <int> ages = {39, 44, 17, 65, 80, 21, 33, 58, 90, 12};
+
+	size_t young = updateWhere(ages.data(), ages.size(), Always{}, SetTo{21});
+	cout << young << " ages changed to 21 (one was already 21)" << endl;
+
+	ages = {39, 44, 17, 65, 80, 21, 33, 58, 90, 12};
+	size_t capped = updateWhere(ages.data(), ages.size(), Above{50}, SetTo{50});
+	cout << "Capped " << capped << " ages at 50 :";
+	for(int age : ages) cout << " " << age;
+	cout << endl;
+
+	// ---------- WHOLE COLUMNS ----------
+	// Pass the number of animals and threads on the command line
+
+	size_t n = (argc > 1) ? atoll(argv[1]) : 50000000;
+	unsigned numThreads = (argc > 2) ? atoi(argv[2]) : thread::hardware_concurrency();
+	if(numThreads == 0) numThreads = 1;
+
+	Xoshiro256pp gen(2024);
+	vector <int> age(n), height(n), weight(n);
+	for(size_t i = 0; i < n; i++){
+		age[i] = boundedRand(gen, 100);
+		height[i] = 10 + boundedRand(gen, 200);
+		weight[i] = 1 + boundedRand(gen, 500);
+	}
+
+	vector <int> ageCopy = age;
+	size_t plainChanged = 0;
+
+	// The plain loop everyone writes first
+	double plain = timeIt([&]{
+		for(size_t i = 0; i < n; i++){
+			if(ageCopy[i] > 95){
+				ageCopy[i] = 95;
+				plainChanged++;
+			}
+		}
+	});
+
+	size_t kernelChanged = 0;
+	double kernel = timeIt([&]{ kernelChanged = updateWhere(age.data(), n, Above{95}, SetTo{95}); });
+
+	cout << "Capping " << n << " ages at 95" << endl;
+	cout << "  plain loop   " << plain << " ms, " << plainChanged << " changed" << endl;
+	cout << "  updateWhere  " << kernel << " ms, " << kernelChanged << " changed, same ages "
+		<< boolalpha << (age == ageCopy) << endl;
+
+	vector <size_t> chunkCounts;
+
+	// Most rules only touch some rows. Every 8 lane group is still tested and
+	// stored, the masked store just leaves the rows that fail alone
+	size_t grown = 0;
+	double grow = timeIt([&]{
+		grown = parallelUpdate(height.data(), height.data(), n, Below{20}, AddDelta{2},
+			numThreads, chunkCounts);
+	});
+	cout << "  heights below 20 plus 2 on " << numThreads << " threads " << grow << " ms, "
+		<< grown << " changed" << endl;
+
+	// Every weight of an animal taller than 150 is kept between 50 and 300
+	size_t clamped = 0;
+	double clamp = timeIt([&]{
+		clamped = parallelUpdate(height.data(), weight.data(), n, Above{150}, ClampTo{50, 300},
+			numThreads, chunkCounts);
+	});
+	cout << "  clamped weights of tall animals " << clamp << " ms, " << clamped << " changed" << endl;
+
+	cout << "  changes in the first chunks :";
+	for(size_t c = 0; c < min<size_t>(5, chunkCounts.size()); c++) cout << " " << chunkCounts[c];
+	cout << endl;
+
+	// Adding to everything changes every value, so every group is stored
+	double added = timeIt([&]{
+		parallelUpdate(weight.data(), weight.data(), n, Always{}, AddDelta{1}, numThreads, chunkCounts);
+	});
+	cout << "  every weight plus 1 " << added << " ms" << endl;
+
+	return 0;
+}
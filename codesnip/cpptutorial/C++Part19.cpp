@@ -0,0 +1,301 @@
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+#include <chrono>
+#include <type_traits>
+#include <cstdlib>
+#include <cstdint>
+#include "Random.h"
+
+using namespace std;
+
+// Expression Templates
+// With a column of heights and a column of weights for every animal, a
+// BMI like number is weight / (height * height). Written with vectors
+// that is one loop for height * height into a temporary vector and then a
+// second loop for the division, so every number goes through memory twice
+//
+// Here + - * / on columns don't compute anything. They build a small tree
+// of types that remembers what to do
+//
+//   weight / (height * height)  is  BinaryOp<Column, BinaryOp<Column, Column, Mul>, Div>
+//
+// Nothing happens until the tree is assigned to a Column. Then one loop
+// runs over the rows and works out the whole expression for each row, so
+// there are no temporary vectors. The loop is simple enough that the
+// compiler vectorizes it with -O3, so it is one SIMD loop too
+// assign(expr, numThreads) splits the rows between threads
+
+// Every expression derives from Expr<itself> so the operators below only
+// accept expressions
+template <typename E>
+struct Expr{
+	const E& self() const { return static_cast<const E&>(*this); }
+};
+
+template <typename T>
+class Column;
+
+// Columns are held by reference and everything else by value, because
+// the small nodes are temporaries that are gone by the time the
+// expression is evaluated
+template <typename E>
+struct StoredAs{ using type = E; };
+
+template <typename T>
+struct StoredAs<Column<T>>{ using type = const Column<T>&; };
+
+// The size of an expression with no columns in it, which fits any
+// number of rows. An empty column has a real size of 0
+constexpr size_t anySize = SIZE_MAX;
+
+// A plain number used in an expression like height * 2
+template <typename T>
+class Scalar : public Expr<Scalar<T>>{
+
+	private:
+		T value;
+
+	public:
+		Scalar(T value) : value(value) {}
+		T operator[](size_t) const { return value; }
+
+		size_t size() const { return anySize; }
+
+		bool reads(const void*) const { return false; }
+
+};
+
+// The two sides can be different types, like a float column times 2, and
+// the result is the type C++ would give a * b
+struct Add{ template <typename A, typename B> static common_type_t<A, B> apply(A a, B b){ return a + b; } };
+struct Sub{ template <typename A, typename B> static common_type_t<A, B> apply(A a, B b){ return a - b; } };
+struct Mul{ template <typename A, typename B> static common_type_t<A, B> apply(A a, B b){ return a * b; } };
+struct Div{ template <typename A, typename B> static common_type_t<A, B> apply(A a, B b){ return a / b; } };
+
+template <typename Left, typename Right, typename Op>
+class BinaryOp : public Expr<BinaryOp<Left, Right, Op>>{
+
+	private:
+		typename StoredAs<Left>::type left;
+		typename StoredAs<Right>::type right;
+
+	public:
+		BinaryOp(const Left& left, const Right& right) : left(left), right(right) {
+			if(left.size() != anySize && right.size() != anySize && left.size() != right.size())
+				throw invalid_argument("columns in an expression have different sizes");
+		}
+
+		auto operator[](size_t i) const { return Op::apply(left[i], right[i]); }
+
+		size_t size() const { return (left.size() == anySize) ? right.size() : left.size(); }
+
+		// true if the expression reads the column whose values are at data
+		bool reads(const void* data) const { return left.reads(data) || right.reads(data); }
+
+};
+
+template <typename T>
+class Column : public Expr<Column<T>>{
+
+	private:
+		vector <T> values;
+
+		// Works out rows [start, end) of expr. out is __restrict so the
+		// compiler knows writing it can't change the columns being read.
+		// When it can, as in a = a + b, the plain loop is used. Row i only
+		// ever reads row i so that is still right, just not vectorized
+		template <typename E>
+		void evaluate(const E& expr, size_t start, size_t end, bool aliased){
+			if(aliased){
+				T* out = values.data();
+				for(size_t i = start; i < end; i++) out[i] = expr[i];
+				return;
+			}
+			T* __restrict out = values.data();
+			for(size_t i = start; i < end; i++) out[i] = expr[i];
+		}
+
+	public:
+		explicit Column(size_t n = 0, T value = T()) : values(n, value) {}
+
+		size_t size() const { return values.size(); }
+		T& operator[](size_t i){ return values[i]; }
+		const T& operator[](size_t i) const { return values[i]; }
+		T* data(){ return values.data(); }
+
+		bool reads(const void* data) const { return data == values.data(); }
+
+		// Works out the whole expression in one pass. The result can also be
+		// one of the columns in the expression
+		template <typename E>
+		Column& assign(const Expr<E>& e, unsigned numThreads = 1){
+
+			const E& expr = e.self();
+			size_t n = expr.size();
+			if(n == anySize) throw invalid_argument("an expression needs at least one column");
+
+			// Checked before resize can move values. A column in the
+			// expression has n rows, so when this one is read it already
+			// has n rows and isn't moved
+			bool aliased = expr.reads(values.data());
+			values.resize(n);
+			if(numThreads <= 1){
+				evaluate(expr, 0, n, aliased);
+				return *this;
+			}
+
+			// Slices are rounded to 16 rows so threads don't share the
+			// cache line at the edge of a slice
+			size_t slice = ((n + numThreads - 1) / numThreads + 15) / 16 * 16;
+			vector <thread> workers;
+
+			for(unsigned t = 0; t < numThreads; t++){
+				size_t start = min(n, t * slice);
+				size_t end = min(n, start + slice);
+				workers.emplace_back([this, &expr, start, end, aliased]{ evaluate(expr, start, end, aliased); });
+			}
+
+			for(thread& worker : workers) worker.join();
+			return *this;
+
+		}
+
+		template <typename E>
+		Column& operator=(const Expr<E>& e){ return assign(e); }
+
+};
+
+// ---------- OPERATORS ----------
+// expr op expr, expr op number and number op expr for + - * /
+
+#define COLUMN_OPERATOR(symbol, Op)                                                     \
+template <typename L, typename R>                                                       \
+BinaryOp<L, R, Op> operator symbol(const Expr<L>& a, const Expr<R>& b){                \
+	return BinaryOp<L, R, Op>(a.self(), b.self());                                      \
+}                                                                                       \
+template <typename L, typename T, typename = enable_if_t<is_arithmetic<T>::value>>      \
+BinaryOp<L, Scalar<T>, Op> operator symbol(const Expr<L>& a, T b){                     \
+	return BinaryOp<L, Scalar<T>, Op>(a.self(), Scalar<T>(b));                          \
+}                                                                                       \
+template <typename T, typename R, typename = enable_if_t<is_arithmetic<T>::value>>      \
+BinaryOp<Scalar<T>, R, Op> operator symbol(T a, const Expr<R>& b){                     \
+	return BinaryOp<Scalar<T>, R, Op>(Scalar<T>(a), b.self());                          \
+}
+
+COLUMN_OPERATOR(+, Add)
+COLUMN_OPERATOR(-, Sub)
+COLUMN_OPERATOR(*, Mul)
+COLUMN_OPERATOR(/, Div)
+
+#undef COLUMN_OPERATOR
+
+// Time how long it takes to run a function in milliseconds
+template <typename Func>
+double timeIt(Func func){
+
+	auto start = chrono::steady_clock::now();
+	func();
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count();
+
+}
+
+int main(int argc, char* argv[]){
+
+	// ---------- A FEW ANIMALS ----------
+	// Heights in metres and weights in kilograms
+
+	Column <float> height(4), weight(4);
+	float heights[4] = {0.33f, 0.5f, 1.8f, 0.25f};
+	float weights[4] = {10, 25, 80, 4};
+	for(size_t i = 0; i < 4; i++){
+		height[i] = heights[i];
+		weight[i] = weights[i];
+	}
+
+	Column <float> bmi;
+	bmi = weight / (height * height);
+
+	Column <float> score;
+	score = height * 2 + weight;
+
+	// The result can be in the expression too
+	Column <float> growth(4, 1.0f);
+	growth = growth + height / 10;
+
+	for(size_t i = 0; i < 4; i++)
+		cout << "Height " << height[i] << " weight " << weight[i] << " BMI " << bmi[i]
+			<< " score " << score[i] << " growth " << growth[i] << endl;
+
+	try{
+		Column <float> shortColumn(3);
+		bmi = weight / shortColumn;
+	}
+	catch(invalid_argument& e){
+		cout << e.what() << endl;
+	}
+
+	// An empty column has 0 rows, it doesn't fit any size like a number
+	try{
+		Column <float> empty;
+		bmi = empty + weight;
+	}
+	catch(invalid_argument& e){
+		cout << e.what() << endl;
+	}
+
+	// ---------- MILLIONS OF ANIMALS ----------
+	// Pass the number of animals and threads on the command line
+
+	size_t n = (argc > 1) ? atoll(argv[1]) : 50000000;
+	unsigned numThreads = (argc > 2) ? atoi(argv[2]) : thread::hardware_concurrency();
+	if(numThreads == 0) numThreads = 1;
+
+	Xoshiro256pp gen(2024);
+	Column <float> heightCol(n), weightCol(n), result(n);
+	for(size_t i = 0; i < n; i++){
+		heightCol[i] = 0.1f + boundedRand(gen, 200) / 100.0f;
+		weightCol[i] = 1.0f + boundedRand(gen, 500);
+	}
+
+	// The usual way with a temporary vector for every step
+	vector <float> squared(n), separate(n);
+	double temporaries = timeIt([&]{
+		for(size_t i = 0; i < n; i++) squared[i] = heightCol[i] * heightCol[i];
+		for(size_t i = 0; i < n; i++) separate[i] = weightCol[i] / squared[i];
+	});
+
+	double fused = timeIt([&]{ result = weightCol / (heightCol * heightCol); });
+
+	bool same = true;
+	for(size_t i = 0; i < n; i++) same = same && (result[i] == separate[i]);
+
+	double threaded = timeIt([&]{ result.assign(weightCol / (heightCol * heightCol), numThreads); });
+
+	cout << "BMI of " << n << " animals" << endl;
+	cout << "  separate loops    " << temporaries << " ms" << endl;
+	cout << "  fused             " << fused << " ms, same answers " << boolalpha << same << endl;
+	cout << "  fused " << numThreads << " threads   " << threaded << " ms" << endl;
+
+	// A longer expression where temporaries cost even more
+	vector <float> doubled(n), summed(n), longWay(n);
+	temporaries = timeIt([&]{
+		for(size_t i = 0; i < n; i++) doubled[i] = heightCol[i] * 2.0f;
+		for(size_t i = 0; i < n; i++) summed[i] = doubled[i] + weightCol[i];
+		for(size_t i = 0; i < n; i++) longWay[i] = summed[i] - 1.0f / heightCol[i];
+	});
+
+	fused = timeIt([&]{ result.assign(heightCol * 2.0f + weightCol - 1.0f / heightCol, numThreads); });
+
+	same = true;
+	for(size_t i = 0; i < n; i++) same = same && (result[i] == longWay[i]);
+
+	cout << "height * 2 + weight - 1 / height" << endl;
+	cout << "  separate loops    " << temporaries << " ms" << endl;
+	cout << "  fused             " << fused << " ms, same answers " << same << endl;
+
+	return 0;
+}
@@ -0,0 +1,489 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include "Random.h"
+
+using namespace std;
+
+// Live Totals for Every Animal
+// The Animal class from Part1 counts animals with numOfAnimals. A
+// dashboard also wants the total, mean, smallest and biggest height and
+// weight of every animal alive right now. Scanning every animal for that
+// takes longer the more animals there are
+// Here the totals are kept up to date as animals change. The constructor,
+// the destructor, setHeight, setWeight and setAll each update them in O(1)
+//
+// It is opt in. Animal<> keeps nothing, Animal<LiveStats> keeps the
+// totals, and NoStats compiles down to nothing at all
+//
+// Min and max can't be kept with one number, because when the smallest
+// animal grows we need the next smallest. So LiveStats counts how many
+// animals have each height from 0 to 65535, plus a coarse count for each
+// block of 256 heights. The smallest is the first nonzero coarse block and
+// then the first nonzero count inside it. Weights work the same way
+//
+// Every thread writes to its own shard of counters, so threads changing
+// animals at the same time never share a cache line and need no locked
+// instructions. An animal can be made on one thread and changed on
+// another, so one shard's count can go below 0, but the shards always add
+// up right. summary() adds up the shards, which takes microseconds. It is
+// a snapshot. Changes made while it runs may be partly counted
+
+struct PopulationSummary{
+	long long count;
+	long long totalHeight;
+	long long totalWeight;
+	double meanHeight;
+	double meanWeight;
+	int minHeight;
+	int maxHeight;
+	int minWeight;
+	int maxWeight;
+};
+
+// Keeps nothing
+struct NoStats{
+	static void added(int, int){}
+	static void removed(int, int){}
+	static void heightChanged(int, int){}
+	static void weightChanged(int, int){}
+};
+
+class LiveStats{
+
+	public:
+		static constexpr int maxValue = 65535;
+
+	private:
+		// Only the thread that owns a shard writes to it, so a counter is
+		// changed with a plain load and store instead of a locked add.
+		// They are still atomics so summary() can read them safely
+		static void bump(atomic <long long>& counter, long long by){
+			counter.store(counter.load(memory_order_relaxed) + by, memory_order_relaxed);
+		}
+
+		// Counts for one of height or weight
+		struct Field{
+			atomic <long long> sum{0};
+			atomic <long long> coarse[(maxValue + 1) / 256] = {};
+			atomic <long long> fine[maxValue + 1] = {};
+
+			void add(int value, long long count){
+				bump(sum, value * count);
+				bump(coarse[value >> 8], count);
+				bump(fine[value], count);
+			}
+		};
+
+		struct alignas(64) Shard{
+			atomic <long long> count{0};
+			Field height;
+			Field weight;
+		};
+
+		// Shards outlive their threads because their counts are still
+		// part of the totals. When a thread ends its shard goes on the free
+		// list and the next new thread carries on counting in it, so there
+		// are only ever as many shards as threads alive at once. A shard
+		// is about 1 MB
+		static mutex shardsMutex;
+		static vector <unique_ptr<Shard>> shards;
+		static vector <Shard*> freeShards;
+
+		// The thread's shard. Plain pointers and bools need no destructor,
+		// so they can still be used while other thread_locals are being
+		// destroyed at thread exit
+		static thread_local Shard* current;
+		static thread_local bool leaseEnded;
+
+		// Gives the thread's shard back when the thread ends and forgets
+		// it, so nothing else in this thread writes to it once another
+		// thread may own it. The mutex makes the old thread's counts
+		// visible to the next one
+		struct ShardLease{
+			~ShardLease(){
+				leaseEnded = true;
+				if(current == nullptr) return;
+				lock_guard <mutex> lock(shardsMutex);
+				freeShards.push_back(current);
+				current = nullptr;
+			}
+		};
+
+		// Each thread gets its shard the first time it changes an animal
+		// A change made later in the thread's teardown, after the lease
+		// gave the shard back, takes a new shard. Nothing can give that one
+		// back, so it stays out of the free list and its counts stay in
+		// the totals
+		static Shard& myShard(){
+			if(current == nullptr){
+				{
+					lock_guard <mutex> lock(shardsMutex);
+					if(freeShards.empty()){
+						shards.push_back(make_unique<Shard>());
+						current = shards.back().get();
+					}
+					else{
+						current = freeShards.back();
+						freeShards.pop_back();
+					}
+				}
+				if(!leaseEnded){
+					thread_local ShardLease lease;
+					(void) lease;
+				}
+			}
+			return *current;
+		}
+
+		static void check(int value){
+			if(value < 0 || value > maxValue)
+				throw out_of_range("LiveStats only tracks values from 0 to " + to_string(maxValue));
+		}
+
+		// The count of every shard for one coarse block or one value
+		static long long coarseTotal(Field Shard::* field, int block){
+			long long total = 0;
+			for(auto& shard : shards) total += ((*shard).*field).coarse[block].load(memory_order_relaxed);
+			return total;
+		}
+
+		static long long fineTotal(Field Shard::* field, int value){
+			long long total = 0;
+			for(auto& shard : shards) total += ((*shard).*field).fine[value].load(memory_order_relaxed);
+			return total;
+		}
+
+		// The smallest value with a nonzero count, looking in the coarse
+		// blocks first. Returns -1 when there are none
+		static int lowest(Field Shard::* field){
+			for(int block = 0; block <= maxValue >> 8; block++){
+				if(coarseTotal(field, block) == 0) continue;
+				for(int value = block << 8; value < (block + 1) << 8; value++)
+					if(fineTotal(field, value) != 0) return value;
+			}
+			return -1;
+		}
+
+		static int highest(Field Shard::* field){
+			for(int block = maxValue >> 8; block >= 0; block--){
+				if(coarseTotal(field, block) == 0) continue;
+				for(int value = ((block + 1) << 8) - 1; value >= block << 8; value--)
+					if(fineTotal(field, value) != 0) return value;
+			}
+			return -1;
+		}
+
+	public:
+		static void added(int height, int weight){
+			check(height);
+			check(weight);
+			Shard& shard = myShard();
+			bump(shard.count, 1);
+			shard.height.add(height, 1);
+			shard.weight.add(weight, 1);
+		}
+
+		static void removed(int height, int weight){
+			Shard& shard = myShard();
+			bump(shard.count, -1);
+			shard.height.add(height, -1);
+			shard.weight.add(weight, -1);
+		}
+
+		static void heightChanged(int oldHeight, int newHeight){
+			check(newHeight);
+			Shard& shard = myShard();
+			shard.height.add(oldHeight, -1);
+			shard.height.add(newHeight, 1);
+		}
+
+		static void weightChanged(int oldWeight, int newWeight){
+			check(newWeight);
+			Shard& shard = myShard();
+			shard.weight.add(oldWeight, -1);
+			shard.weight.add(newWeight, 1);
+		}
+
+		static size_t numShards(){
+			lock_guard <mutex> lock(shardsMutex);
+			return shards.size();
+		}
+
+		static PopulationSummary summary(){
+
+			lock_guard <mutex> lock(shardsMutex);
+
+			PopulationSummary s{};
+			for(auto& shard : shards){
+				s.count += shard -> count.load(memory_order_relaxed);
+				s.totalHeight += shard -> height.sum.load(memory_order_relaxed);
+				s.totalWeight += shard -> weight.sum.load(memory_order_relaxed);
+			}
+
+			if(s.count > 0){
+				s.meanHeight = double(s.totalHeight) / s.count;
+				s.meanWeight = double(s.totalWeight) / s.count;
+			}
+
+			s.minHeight = lowest(&Shard::height);
+			s.maxHeight = highest(&Shard::height);
+			s.minWeight = lowest(&Shard::weight);
+			s.maxWeight = highest(&Shard::weight);
+			return s;
+
+		}
+
+};
+
+mutex LiveStats::shardsMutex;
+vector <unique_ptr<LiveStats::Shard>> LiveStats::shards;
+vector <LiveStats::Shard*> LiveStats::freeShards;
+thread_local LiveStats::Shard* LiveStats::current = nullptr;
+thread_local bool LiveStats::leaseEnded = false;
+
+// ---------- ANIMAL ----------
+// The Part1 Animal with a Stats policy told about every change
+
+template <typename Stats = NoStats>
+class Animal{
+
+	private:
+		int height;
+		int weight;
+		string name;
+
+	public:
+		Animal(int height, int weight, string name) : height(height), weight(weight), name(name) {
+			Stats::added(height, weight);
+		}
+
+		Animal() : Animal(0, 0, "") {}
+
+		// Declaring the copy stops the compiler making a move constructor,
+		// so moves copy too and the moved from animal is still counted
+		// until its destructor runs
+		Animal(const Animal& other) : Animal(other.height, other.weight, other.name) {}
+
+		Animal& operator=(const Animal& other){
+			setAll(other.height, other.weight, other.name);
+			return *this;
+		}
+
+		~Animal(){ Stats::removed(height, weight); }
+
+		int getHeight() const { return height; }
+		int getWeight() const { return weight; }
+		string getName() const { return name; }
+
+		void setHeight(int cm){
+			Stats::heightChanged(height, cm);
+			height = cm;
+		}
+
+		void setWeight(int kg){
+			Stats::weightChanged(weight, kg);
+			weight = kg;
+		}
+
+		void setName(string animalName){ name = animalName; }
+
+		// The new animal is made first so if a value is refused nothing
+		// has changed. Swapping then hands the old values to the temporary,
+		// whose destructor takes them out of the stats
+		void setAll(int height, int weight, string name){
+			Animal updated(height, weight, move(name));
+			swap(this -> height, updated.height);
+			swap(this -> weight, updated.weight);
+			swap(this -> name, updated.name);
+		}
+
+		void toString() const {
+			cout << this -> name << " is " << this -> height << " cms tall and "
+				<< this -> weight << " kgs in weight" << endl;
+		}
+
+};
+
+// The old way, looking at every animal
+template <typename Stats>
+PopulationSummary scanSummary(const vector <Animal<Stats>>& animals){
+
+	PopulationSummary s{};
+	s.count = animals.size();
+	s.minHeight = s.minWeight = -1;
+	s.maxHeight = s.maxWeight = -1;
+	if(animals.empty()) return s;
+
+	s.minHeight = s.maxHeight = animals[0].getHeight();
+	s.minWeight = s.maxWeight = animals[0].getWeight();
+
+	for(const Animal<Stats>& animal : animals){
+		int h = animal.getHeight();
+		int w = animal.getWeight();
+		s.totalHeight += h;
+		s.totalWeight += w;
+		s.minHeight = min(s.minHeight, h);
+		s.maxHeight = max(s.maxHeight, h);
+		s.minWeight = min(s.minWeight, w);
+		s.maxWeight = max(s.maxWeight, w);
+	}
+
+	s.meanHeight = double(s.totalHeight) / s.count;
+	s.meanWeight = double(s.totalWeight) / s.count;
+	return s;
+
+}
+
+void printSummary(const PopulationSummary& s){
+	cout << "  " << s.count << " animals, height mean " << s.meanHeight << " min " << s.minHeight
+		<< " max " << s.maxHeight << ", weight mean " << s.meanWeight << " min " << s.minWeight
+		<< " max " << s.maxWeight << endl;
+}
+
+bool sameSummary(const PopulationSummary& a, const PopulationSummary& b){
+	return a.count == b.count && a.totalHeight == b.totalHeight && a.totalWeight == b.totalWeight &&
+		a.minHeight == b.minHeight && a.maxHeight == b.maxHeight &&
+		a.minWeight == b.minWeight && a.maxWeight == b.maxWeight;
+}
+
+// Time how long it takes to run a function in microseconds
+template <typename Func>
+double timeIt(Func func){
+
+	auto start = chrono::steady_clock::now();
+	func();
+	chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count();
+
+}
+
+// Each thread changes the heights and weights of its own slice of animals
+template <typename Stats>
+void changeAll(vector <Animal<Stats>>& animals, unsigned numThreads, int rounds){
+
+	vector <thread> workers;
+	size_t slice = (animals.size() + numThreads - 1) / numThreads;
+
+	for(unsigned t = 0; t < numThreads; t++){
+		size_t start = min(animals.size(), t * slice);
+		size_t end = min(animals.size(), start + slice);
+		workers.emplace_back([&animals, t, start, end, rounds]{
+			Xoshiro256pp gen = Xoshiro256pp::forStream(7, t);
+			for(int r = 0; r < rounds; r++){
+				for(size_t i = start; i < end; i++){
+					animals[i].setHeight(20 + boundedRand(gen, 200));
+					animals[i].setWeight(1 + boundedRand(gen, 100));
+				}
+			}
+		});
+	}
+
+	for(thread& worker : workers) worker.join();
+
+}
+
+int main(int argc, char* argv[]){
+
+	// ---------- THE PART1 ANIMALS ----------
+
+	{
+		Animal<LiveStats> fred(33, 10, "Fred");
+		Animal<LiveStats> tom;
+		tom.setAll(36, 15, "Tom");
+		tom.toString();
+
+		printSummary(LiveStats::summary());
+
+		fred.setHeight(40);
+		cout << "Fred grew to 40" << endl;
+		printSummary(LiveStats::summary());
+
+		try{
+			tom.setWeight(-5);
+		}
+		catch(out_of_range& e){
+			cout << e.what() << endl;
+		}
+
+		// The bad weight is refused before the height changes
+		try{
+			tom.setAll(50, -5, "Tom");
+		}
+		catch(out_of_range& e){
+			cout << "setAll refused, Tom is still " << tom.getHeight() << " cms" << endl;
+		}
+		printSummary(LiveStats::summary());
+	}
+
+	cout << "After Fred and Tom are destroyed" << endl;
+	printSummary(LiveStats::summary());
+
+	// ---------- MILLIONS OF ANIMALS ----------
+	// Pass the number of animals and threads on the command line
+
+	size_t n = (argc > 1) ? atoll(argv[1]) : 5000000;
+	unsigned numThreads = (argc > 2) ? atoi(argv[2]) : thread::hardware_concurrency();
+	if(numThreads == 0) numThreads = 1;
+
+	Xoshiro256pp gen(2024);
+	vector <Animal<>> plainAnimals;
+	vector <Animal<LiveStats>> liveAnimals;
+	plainAnimals.reserve(n);
+	liveAnimals.reserve(n);
+
+	for(size_t i = 0; i < n; i++){
+		int h = 20 + boundedRand(gen, 200);
+		int w = 1 + boundedRand(gen, 100);
+		plainAnimals.emplace_back(h, w, "Rex");
+		liveAnimals.emplace_back(h, w, "Rex");
+	}
+
+	double plainSetters = timeIt([&]{ changeAll(plainAnimals, numThreads, 2); });
+	double liveSetters = timeIt([&]{ changeAll(liveAnimals, numThreads, 2); });
+
+	cout << "Changing " << n << " animals twice on " << numThreads << " threads" << endl;
+	cout << "  Animal<>           " << plainSetters / 1000 << " ms" << endl;
+	cout << "  Animal<LiveStats>  " << liveSetters / 1000 << " ms" << endl;
+
+	PopulationSummary live, scanned;
+	double query = timeIt([&]{ live = LiveStats::summary(); });
+	double scan = timeIt([&]{ scanned = scanSummary(liveAnimals); });
+
+	printSummary(live);
+	cout << "  summary() " << query << " us, scanning every animal " << scan / 1000
+		<< " ms, same answers " << boolalpha << sameSummary(live, scanned) << endl;
+
+	liveAnimals.resize(n / 2);
+	cout << "After half of them are destroyed, same answers "
+		<< sameSummary(LiveStats::summary(), scanSummary(liveAnimals)) << endl;
+
+	// Threads that have ended hand their shards on, so running the
+	// threads again makes no new shards
+	size_t shardsBefore = LiveStats::numShards();
+	for(int run = 0; run < 5; run++) changeAll(liveAnimals, numThreads, 1);
+	cout << "After 5 more runs of " << numThreads << " threads there are " << LiveStats::numShards()
+		<< " shards (" << shardsBefore << " before), same answers "
+		<< sameSummary(LiveStats::summary(), scanSummary(liveAnimals)) << endl;
+
+	// pet is made before the thread's lease and so destroyed after it.
+	// Removing the animal then writes to a shard of its own and not the
+	// one the lease gave back
+	thread([]{
+		thread_local unique_ptr <Animal<LiveStats>> pet;
+		pet = make_unique<Animal<LiveStats>>(50, 20, "Rex");
+	}).join();
+	cout << "After a thread's last animal is destroyed at thread exit, same answers "
+		<< sameSummary(LiveStats::summary(), scanSummary(liveAnimals)) << endl;
+
+	return 0;
+}
@@ -0,0 +1,335 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <climits>
+#include "Random.h"
+
+using namespace std;
+
+// Ranking Animals by Height
+// "How many animals are between 50 and 80 cms tall?" and "How tall is the
+// 10th tallest animal?" are easy to answer by looking at every animal, but
+// that is slow when there are millions and we ask often while heights
+// keep changing through setHeight
+// HeightIndex answers both in O(log n) where n is the number of possible
+// heights, not the number of animals. It is a Fenwick tree (also called a
+// binary indexed tree). Slot i of the tree holds the number of animals
+// whose height is in a range of heights ending at i, where the size of the
+// range is the lowest set bit of i. Any count of heights below x is the
+// sum of at most log n slots, and a change touches at most log n slots
+//
+// Animals that are given an index tell it about every setHeight
+//
+// Lots of setHeight calls in a row can be queued with deferUpdates(true).
+// Queued changes are sorted so changes to the same height cancel out and
+// nearby heights update the tree together. The counts of every height
+// are changed right away and only the tree waits. Once the queue is so
+// big that rebuilding the whole tree in one pass is cheaper, the queue is
+// dropped and the tree is marked to be rebuilt, so a long run of changes
+// never holds more than a few entries per tree slot. Queries bring the
+// tree up to date first so they never see old counts
+
+class HeightIndex{
+
+	private:
+		int maxValue;
+		size_t size;              // a power of 2 bigger than maxValue
+		vector <long long> tree;  // tree[1..size], tree[v + 1] is for height v
+		vector <long long> counts;
+		long long total;
+
+		bool deferring;
+		vector <pair<int, long long>> pending;
+		bool stale;               // the tree is rebuilt from counts, pending isn't needed
+
+		void check(int value) const {
+			if(value < 0 || value > maxValue)
+				throw out_of_range("height " + to_string(value) + " isn't between 0 and " + to_string(maxValue));
+		}
+
+		void addToTree(int value, long long delta){
+			for(size_t i = value + 1; i <= size; i += i & (0 - i)) tree[i] += delta;
+		}
+
+		// Every slot adds itself to the one slot above it that covers it
+		void rebuild(){
+			fill(tree.begin(), tree.end(), 0);
+			for(size_t v = 0; v < counts.size(); v++) tree[v + 1] = counts[v];
+			for(size_t i = 1; i <= size; i++){
+				size_t parent = i + (i & (0 - i));
+				if(parent <= size) tree[parent] += tree[i];
+			}
+		}
+
+		// Applies the queue to the tree sorted by height so equal heights
+		// are added up first and slots near each other are touched together
+		void flush(){
+
+			if(stale){
+				rebuild();
+				stale = false;
+				return;
+			}
+
+			if(pending.empty()) return;
+
+			sort(pending.begin(), pending.end());
+			for(size_t i = 0; i < pending.size();){
+				int value = pending[i].first;
+				long long delta = 0;
+				for(; i < pending.size() && pending[i].first == value; i++) delta += pending[i].second;
+				if(delta != 0) addToTree(value, delta);
+			}
+
+			pending.clear();
+
+		}
+
+		void change(int value, long long delta){
+			total += delta;
+			counts[value] += delta;
+			if(!deferring) addToTree(value, delta);
+			else if(!stale){
+				pending.push_back({value, delta});
+				if(pending.size() > size / 8){
+					pending.clear();
+					stale = true;
+				}
+			}
+		}
+
+	public:
+		explicit HeightIndex(int maxValue) : maxValue(maxValue), size(1), total(0), deferring(false), stale(false) {
+			if(maxValue < 0) throw invalid_argument("HeightIndex needs a maxValue of at least 0");
+			while(size <= size_t(maxValue)) size *= 2;
+			tree.assign(size + 1, 0);
+			counts.assign(maxValue + 1, 0);
+		}
+
+		void add(int value){ check(value); change(value, 1); }
+		void remove(int value){ check(value); change(value, -1); }
+
+		void move(int oldValue, int newValue){
+			check(oldValue);
+			check(newValue);
+			if(oldValue == newValue) return;
+			change(oldValue, -1);
+			change(newValue, 1);
+		}
+
+		// Turning deferring off applies the queue
+		void deferUpdates(bool on){
+			if(!on) flush();
+			deferring = on;
+		}
+
+		long long count(){ return total; }
+
+		// Number of animals shorter than value
+		long long countBelow(int value){
+			flush();
+			if(value <= 0) return 0;
+			long long sum = 0;
+			for(size_t i = min(value, maxValue + 1); i > 0; i -= i & (0 - i)) sum += tree[i];
+			return sum;
+		}
+
+		// Number of animals with low <= height <= high. high is cut down to
+		// maxValue first so high + 1 can't overflow
+		long long countBetween(int low, int high){
+			if(high < low) return 0;
+			return countBelow(min(high, maxValue) + 1) - countBelow(low);
+		}
+
+		// The k'th shortest height, k starting at 1. Walks down the tree
+		// taking the biggest jump that stays below k animals each time
+		int kthSmallest(long long k){
+
+			flush();
+			if(k < 1 || k > total) throw out_of_range("there is no animal number " + to_string(k));
+
+			size_t pos = 0;
+			for(size_t step = size; step > 0; step /= 2){
+				if(pos + step <= size && tree[pos + step] < k){
+					pos += step;
+					k -= tree[pos];
+				}
+			}
+			return pos;
+
+		}
+
+		int kthTallest(long long k){
+			if(k < 1 || k > total) throw out_of_range("there is no animal number " + to_string(k));
+			return kthSmallest(total - k + 1);
+		}
+
+};
+
+// ---------- ANIMAL ----------
+// The Part1 Animal, optionally connected to an index of heights
+
+class Animal{
+
+	private:
+		int height;
+		int weight;
+		string name;
+		HeightIndex* index;
+
+	public:
+		Animal(int height, int weight, string name, HeightIndex* index = nullptr)
+			: height(height), weight(weight), name(name), index(index) {
+			if(index) index -> add(height);
+		}
+
+		Animal(const Animal& other) : Animal(other.height, other.weight, other.name, other.index) {}
+
+		Animal& operator=(const Animal& other){
+			if(index != other.index){
+				if(index) index -> remove(height);
+				if(other.index) other.index -> add(other.height);
+				index = other.index;
+				height = other.height;
+			}
+			else setHeight(other.height);
+			weight = other.weight;
+			name = other.name;
+			return *this;
+		}
+
+		~Animal(){ if(index) index -> remove(height); }
+
+		int getHeight() const { return height; }
+		int getWeight() const { return weight; }
+		string getName() const { return name; }
+
+		void setHeight(int cm){
+			if(index) index -> move(height, cm);
+			height = cm;
+		}
+
+		void setWeight(int kg){ weight = kg; }
+		void setName(string animalName){ name = animalName; }
+
+		void setAll(int height, int weight, string name){
+			setHeight(height);
+			this -> weight = weight;
+			this -> name = name;
+		}
+
+};
+
+// Time how long it takes to run a function in milliseconds
+template <typename Func>
+double timeIt(Func func){
+
+	auto start = chrono::steady_clock::now();
+	func();
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count();
+
+}
+
+int main(int argc, char* argv[]){
+
+	// ---------- A FEW ANIMALS ----------
+
+	HeightIndex heights(300);
+
+	{
+		Animal fred(33, 10, "Fred", &heights);
+		Animal tom(36, 15, "Tom", &heights);
+		Animal rex(80, 30, "Rex", &heights);
+		Animal spot(52, 20, "Spot", &heights);
+
+		cout << "Between 30 and 50 cms: " << heights.countBetween(30, 50) << endl;
+		cout << "Tallest " << heights.kthTallest(1) << ", 2nd tallest " << heights.kthTallest(2) << endl;
+
+		tom.setHeight(90);
+		cout << "Tom grew to 90. Between 30 and 50 cms: " << heights.countBetween(30, 50)
+			<< ", tallest " << heights.kthTallest(1) << endl;
+
+		try{
+			heights.kthTallest(5);
+		}
+		catch(out_of_range& e){
+			cout << e.what() << endl;
+		}
+	}
+
+	cout << "After they are destroyed there are " << heights.count() << " animals" << endl;
+
+	// ---------- MILLIONS OF ANIMALS ----------
+	// Pass the number of animals and the number of height changes
+
+	size_t n = (argc > 1) ? atoll(argv[1]) : 2000000;
+	size_t numChanges = (argc > 2) ? atoll(argv[2]) : 20000000;
+	const int maxHeight = 65535;
+
+	Xoshiro256pp gen(2024);
+	HeightIndex index(maxHeight);
+	vector <Animal> animals;
+	animals.reserve(n);
+	for(size_t i = 0; i < n; i++) animals.emplace_back(boundedRand(gen, maxHeight + 1), 10, "Rex", &index);
+
+	vector <uint32_t> who(numChanges), newHeight(numChanges);
+	for(size_t i = 0; i < numChanges; i++){
+		who[i] = boundedRand(gen, n);
+		newHeight[i] = boundedRand(gen, maxHeight + 1);
+	}
+
+	// Queries against a scan of every animal
+	long long scanned = 0, indexed = 0;
+	double scan = timeIt([&]{
+		for(int q = 0; q < 10; q++)
+			for(const Animal& animal : animals)
+				scanned += (animal.getHeight() >= 1000 * q && animal.getHeight() <= 1000 * q + 5000);
+	});
+	double ranged = timeIt([&]{
+		for(int q = 0; q < 10; q++) indexed += index.countBetween(1000 * q, 1000 * q + 5000);
+	});
+
+	cout << n << " animals, 10 range counts" << endl;
+	cout << "  scanning " << scan << " ms, HeightIndex " << ranged * 1000 << " us, same counts "
+		<< boolalpha << (scanned == indexed) << endl;
+
+	// The median by sorting a copy against asking the index
+	vector <int> sortedHeights(n);
+	int sortedMedian = 0, indexMedian = 0;
+	double sorting = timeIt([&]{
+		for(size_t i = 0; i < n; i++) sortedHeights[i] = animals[i].getHeight();
+		nth_element(sortedHeights.begin(), sortedHeights.begin() + n / 2, sortedHeights.end());
+		sortedMedian = sortedHeights[n / 2];
+	});
+	double ranking = timeIt([&]{ indexMedian = index.kthSmallest(n / 2 + 1); });
+
+	cout << "  median with nth_element " << sorting << " ms, HeightIndex " << ranking * 1000
+		<< " us, same median " << (sortedMedian == indexMedian) << endl;
+
+	// Changing heights one at a time and then queued
+	double oneAtATime = timeIt([&]{
+		for(size_t i = 0; i < numChanges / 2; i++) animals[who[i]].setHeight(newHeight[i]);
+	});
+
+	double queued = timeIt([&]{
+		index.deferUpdates(true);
+		for(size_t i = numChanges / 2; i < numChanges; i++) animals[who[i]].setHeight(newHeight[i]);
+		index.deferUpdates(false);
+	});
+
+	cout << numChanges / 2 << " setHeight calls" << endl;
+	cout << "  one at a time " << oneAtATime << " ms, queued " << queued << " ms" << endl;
+
+	long long check = 0;
+	for(const Animal& animal : animals) check += (animal.getHeight() < 30000);
+	cout << "  still right after the changes " << (check == index.countBelow(30000)) << endl;
+	cout << "  countBetween(0, INT_MAX) counts every animal " << (index.countBetween(0, INT_MAX) == index.count()) << endl;
+
+	return 0;
+}
@@ -0,0 +1,749 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <unordered_set>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include "Random.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// Sketches of Huge Animal Streams
+// Counting the different names in a stream of a billion animals exactly
+// means remembering every name. Finding the exact 99th percentile weight
+// means keeping and sorting every weight. A sketch is a small summary that
+// gives a close answer with a fixed amount of memory
+//
+// HyperLogLog : roughly how many different names, in 16 KB
+// TDigest     : roughly any percentile of weight or height, in a few KB
+// Reservoir   : a fair random sample of k animals
+//
+// All 3 can be merged. Each shard of a stream builds its own sketches,
+// writes them out with serialize() and they are read back and merged into
+// one. The merged sketch is the same as one built from the whole stream
+//
+// Updates come in batches. HyperLogLog takes an array of hashes and
+// TDigest takes an array of numbers, so the loops over them are tight.
+// Merging HyperLogLogs takes the bigger of 32 registers at a time with AVX2
+
+// ---------- BYTES IN AND OUT ----------
+// Sketches are written as plain bytes into a string
+
+class ByteWriter{
+
+	private:
+		string bytes;
+
+	public:
+		template <typename T>
+		void put(const T& value){
+			static_assert(is_trivially_copyable<T>::value, "only plain values can be written");
+			bytes.append(reinterpret_cast<const char*>(&value), sizeof(T));
+		}
+
+		void putBytes(const void* data, size_t n){ bytes.append(static_cast<const char*>(data), n); }
+
+		const string& result() const { return bytes; }
+
+};
+
+class ByteReader{
+
+	private:
+		const string& bytes;
+		size_t pos = 0;
+
+	public:
+		explicit ByteReader(const string& bytes) : bytes(bytes) {}
+
+		template <typename T>
+		T get(){
+			T value;
+			getBytes(&value, sizeof(T));
+			return value;
+		}
+
+		void getBytes(void* data, size_t n){
+			if(n > bytes.size() - pos) throw runtime_error("sketch data is cut short");
+			memcpy(data, bytes.data() + pos, n);
+			pos += n;
+		}
+
+		void expectTag(const char* tag){
+			char found[4];
+			getBytes(found, 4);
+			if(memcmp(found, tag, 4) != 0) throw runtime_error(string("not a ") + tag + " sketch");
+		}
+
+};
+
+// A 64 bit hash of a name. FNV-1a is quick but its low bits are poor, so
+// the SplitMix64 finisher mixes every bit into every other
+uint64_t hashName(const string& name){
+
+	uint64_t h = 0xcbf29ce484222325ULL;
+	for(unsigned char c : name){
+		h ^= c;
+		h *= 0x100000001b3ULL;
+	}
+
+	h ^= h >> 30;
+	h *= 0xbf58476d1ce4e5b9ULL;
+	h ^= h >> 27;
+	h *= 0x94d049bb133111ebULL;
+	return h ^ (h >> 31);
+
+}
+
+// ---------- HYPERLOGLOG ----------
+// The first 14 bits of a hash pick one of 16384 registers. The rest of the
+// hash starts with some number of 0 bits, and a run of r 0s happens about
+// once in 2^r different hashes. Each register keeps the longest run it has
+// seen plus 1, and the harmonic mean of 2^register over all of them
+// estimates the number of different hashes. The error is about 1.04 /
+// sqrt(16384), so within about 1%
+
+class HyperLogLog{
+
+	public:
+		static const int precision = 14;
+		static const size_t numRegisters = size_t(1) << precision;
+
+	private:
+		vector <uint8_t> registers;
+
+	public:
+		HyperLogLog() : registers(numRegisters, 0) {}
+
+		void addHash(uint64_t h){
+			size_t index = h >> (64 - precision);
+			// The guard bit stops the count at 64 - precision + 1
+			uint8_t rank = __builtin_clzll((h << precision) | (1ULL << (precision - 1))) + 1;
+			if(rank > registers[index]) registers[index] = rank;
+		}
+
+		void addHashes(const uint64_t* hashes, size_t n){
+			for(size_t i = 0; i < n; i++) addHash(hashes[i]);
+		}
+
+		// The merge of two sketches keeps the bigger of each register
+		void merge(const HyperLogLog& other){
+
+			size_t i = 0;
+
+#ifdef __AVX2__
+			for(; i + 32 <= numRegisters; i += 32){
+				__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(registers.data() + i));
+				__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(other.registers.data() + i));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(registers.data() + i), _mm256_max_epu8(a, b));
+			}
+#endif
+
+			for(; i < numRegisters; i++) registers[i] = max(registers[i], other.registers[i]);
+
+		}
+
+		double estimate() const {
+
+			double sum = 0;
+			size_t zeros = 0;
+			for(uint8_t r : registers){
+				sum += ldexp(1.0, -r);
+				zeros += (r == 0);
+			}
+
+			double m = numRegisters;
+			double alpha = 0.7213 / (1 + 1.079 / m);
+			double e = alpha * m * m / sum;
+
+			// With few names most registers are still 0 and counting the
+			// empty ones gives a better answer
+			if(e <= 2.5 * m && zeros > 0) e = m * log(m / zeros);
+			return e;
+
+		}
+
+		string serialize() const {
+			ByteWriter out;
+			out.putBytes("HLL1", 4);
+			out.put<uint8_t>(precision);
+			out.putBytes(registers.data(), registers.size());
+			return out.result();
+		}
+
+		static HyperLogLog deserialize(const string& bytes){
+			ByteReader in(bytes);
+			in.expectTag("HLL1");
+			if(in.get<uint8_t>() != precision) throw runtime_error("HyperLogLog precision doesn't match");
+			HyperLogLog sketch;
+			in.getBytes(sketch.registers.data(), numRegisters);
+			for(uint8_t r : sketch.registers)
+				if(r > 64 - precision + 1) throw runtime_error("HyperLogLog register out of range");
+			return sketch;
+		}
+
+};
+
+// ---------- T-DIGEST ----------
+// Keeps the numbers as a sorted list of centroids, each a mean and a
+// weight (how many numbers it stands for). Centroids near the middle can
+// be big but ones near the smallest and biggest numbers have to stay
+// small, so the 1st and 99th percentiles stay accurate
+// The rule is Dunning's k1 scale. A centroid can only cover the stretch of
+// quantiles where k(q) = compression / (2 pi) * asin(2q - 1) grows by 1
+// New numbers are added to a buffer. When it fills up the buffer and the
+// centroids are sorted together and merged back down
+
+struct Centroid{
+	double mean;
+	double weight;
+	bool operator<(const Centroid& other) const { return mean < other.mean; }
+};
+
+class TDigest{
+
+	private:
+		double compression;
+		vector <Centroid> centroids;
+		vector <Centroid> buffer;
+
+		// The buffer is compressed once it holds bufferLimit numbers. The
+		// sorted buffer and the centroids are merged into scratch, so
+		// neither vector grows past what it needed the first time
+		size_t bufferLimit;
+		vector <Centroid> scratch;
+		double totalWeight = 0;
+		double smallest = INFINITY;
+		double biggest = -INFINITY;
+
+		double scale(double q) const { return compression / (2 * M_PI) * asin(2 * q - 1); }
+		double inverseScale(double k) const { return (sin(k * 2 * M_PI / compression) + 1) / 2; }
+
+		void compress(){
+
+			if(buffer.empty()) return;
+
+			// The centroids are already sorted, so only the buffer needs it
+			sort(buffer.begin(), buffer.end());
+			scratch.resize(buffer.size() + centroids.size());
+			std::merge(buffer.begin(), buffer.end(), centroids.begin(), centroids.end(), scratch.begin());
+			centroids.clear();
+
+			double weightSoFar = 0;
+			Centroid current = scratch[0];
+			double limit = totalWeight * inverseScale(scale(0) + 1);
+
+			for(size_t i = 1; i < scratch.size(); i++){
+				const Centroid& next = scratch[i];
+				if(weightSoFar + current.weight + next.weight <= limit){
+					current.mean += (next.mean - current.mean) * next.weight / (current.weight + next.weight);
+					current.weight += next.weight;
+				}
+				else{
+					weightSoFar += current.weight;
+					centroids.push_back(current);
+					limit = totalWeight * inverseScale(scale(weightSoFar / totalWeight) + 1);
+					current = next;
+				}
+			}
+
+			centroids.push_back(current);
+			buffer.clear();
+
+		}
+
+	public:
+		explicit TDigest(double compression = 200) : compression(compression) {
+			if(!(compression >= 10)) throw invalid_argument("TDigest compression should be at least 10");
+			bufferLimit = size_t(compression * 5);
+			buffer.reserve(bufferLimit);
+		}
+
+		void add(double x, double weight = 1){
+			if(std::isnan(x)) return;
+			buffer.push_back({x, weight});
+			totalWeight += weight;
+			smallest = min(smallest, x);
+			biggest = max(biggest, x);
+			if(buffer.size() >= bufferLimit) compress();
+		}
+
+		// Adds n numbers with one check for a full buffer each
+		void addMany(const double* xs, size_t n){
+
+			for(size_t i = 0; i < n; i++){
+				if(std::isnan(xs[i])) continue;
+				buffer.push_back({xs[i], 1});
+				totalWeight += 1;
+				smallest = min(smallest, xs[i]);
+				biggest = max(biggest, xs[i]);
+				if(buffer.size() >= bufferLimit) compress();
+			}
+
+		}
+
+		void merge(const TDigest& other){
+			for(const Centroid& c : other.centroids) buffer.push_back(c);
+			for(const Centroid& c : other.buffer) buffer.push_back(c);
+			totalWeight += other.totalWeight;
+			smallest = min(smallest, other.smallest);
+			biggest = max(biggest, other.biggest);
+			compress();
+		}
+
+		double count() const { return totalWeight; }
+
+		// How many centroids the buffers have room for, which shouldn't
+		// depend on how many numbers went in
+		size_t bufferRoom() const { return buffer.capacity() + scratch.capacity(); }
+		size_t numCentroids(){ compress(); return centroids.size(); }
+
+		// The value below which a fraction q of the numbers fall. Each
+		// centroid's mean sits at the middle of its weight and values in
+		// between are worked out with a straight line
+		double quantile(double q){
+
+			compress();
+			if(centroids.empty()) throw runtime_error("TDigest is empty");
+			if(q < 0 || q > 1) throw out_of_range("quantile must be between 0 and 1");
+
+			double target = q * totalWeight;
+			if(target <= centroids[0].weight / 2){
+				double t = target / (centroids[0].weight / 2);
+				return smallest + t * (centroids[0].mean - smallest);
+			}
+
+			double weightSoFar = 0;
+			for(size_t i = 0; i + 1 < centroids.size(); i++){
+				double here = weightSoFar + centroids[i].weight / 2;
+				double there = weightSoFar + centroids[i].weight + centroids[i + 1].weight / 2;
+				if(target <= there){
+					double t = (target - here) / (there - here);
+					return centroids[i].mean + t * (centroids[i + 1].mean - centroids[i].mean);
+				}
+				weightSoFar += centroids[i].weight;
+			}
+
+			const Centroid& last = centroids.back();
+			double here = totalWeight - last.weight / 2;
+			double t = (target - here) / (last.weight / 2);
+			return last.mean + t * (biggest - last.mean);
+
+		}
+
+		string serialize(){
+			compress();
+			ByteWriter out;
+			out.putBytes("TDG1", 4);
+			out.put(compression);
+			out.put(totalWeight);
+			out.put(smallest);
+			out.put(biggest);
+			out.put<uint64_t>(centroids.size());
+			out.putBytes(centroids.data(), centroids.size() * sizeof(Centroid));
+			return out.result();
+		}
+
+		static TDigest deserialize(const string& bytes){
+			ByteReader in(bytes);
+			in.expectTag("TDG1");
+			double compression = in.get<double>();
+			if(!(compression >= 10 && compression <= 1e6)) throw runtime_error("TDigest compression doesn't make sense");
+			TDigest digest(compression);
+			digest.totalWeight = in.get<double>();
+			digest.smallest = in.get<double>();
+			digest.biggest = in.get<double>();
+			uint64_t n = in.get<uint64_t>();
+			if(n > bytes.size() / sizeof(Centroid)) throw runtime_error("TDigest centroid count is too big");
+			digest.centroids.resize(n);
+			in.getBytes(digest.centroids.data(), n * sizeof(Centroid));
+
+			// quantile walks the centroids in order and adds up weights, so
+			// they have to be finite, sorted and inside smallest and biggest
+			double weight = 0;
+			for(size_t i = 0; i < n; i++){
+				const Centroid& c = digest.centroids[i];
+				bool valid = std::isfinite(c.mean) && std::isfinite(c.weight) && c.weight > 0
+					&& c.mean >= digest.smallest && c.mean <= digest.biggest
+					&& (i == 0 || digest.centroids[i - 1].mean <= c.mean);
+				if(!valid) throw runtime_error("TDigest centroid " + to_string(i) + " is out of order or not a number");
+				weight += c.weight;
+			}
+			if(!std::isfinite(digest.totalWeight) || fabs(weight - digest.totalWeight) > 1e-6 * weight)
+				throw runtime_error("TDigest weights don't add up");
+			return digest;
+		}
+
+};
+
+// ---------- RESERVOIR ----------
+// A fair sample of k items from a stream of any length. After the first k,
+// item number i replaces a random slot with probability k / i. Instead of
+// drawing for every item, Algorithm L works out how many items to skip
+// before the next one is taken
+// Two reservoirs are merged by filling each slot from one or the other in
+// proportion to how many items each one saw
+// Algorithm L remembers w, the biggest of the k smallest random keys it
+// has handed out. After a merge or when read back from bytes, w is drawn
+// fresh from the distribution it has after seen items, Beta(k, seen - k + 1),
+// so the items that come next are taken as often as they should be
+
+template <typename T>
+class Reservoir{
+
+	static_assert(is_trivially_copyable<T>::value, "Reservoir items are written as bytes");
+
+	private:
+		size_t k;
+		vector <T> items;
+		uint64_t seen = 0;
+		uint64_t nextTake = 0;
+		double w = 1;
+		Xoshiro256pp gen;
+
+		double uniform(){ return ((gen() >> 11) + 0.5) * (1.0 / 9007199254740992.0); }
+
+		// Marsaglia and Tsang's method, for shape of at least 1
+		double gamma(double shape){
+			double d = shape - 1.0 / 3, c = 1 / sqrt(9 * d);
+			while(true){
+				// A normal number by Box-Muller
+				double x = sqrt(-2 * log(uniform())) * cos(2 * M_PI * uniform());
+				double v = 1 + c * x;
+				if(v <= 0) continue;
+				v = v * v * v;
+				if(log(uniform()) < 0.5 * x * x + d - d * v + d * log(v)) return d * v;
+			}
+		}
+
+		void skipAhead(){ nextTake += uint64_t(floor(log(uniform()) / log(1 - w))) + 1; }
+
+		void scheduleNext(){
+			w *= exp(log(uniform()) / k);
+			skipAhead();
+		}
+
+		// Picks up Algorithm L for a full reservoir that has seen items
+		// but doesn't know its w
+		void restart(){
+			double a = gamma(k), b = gamma(double(seen - k) + 1);
+			w = a / (a + b);
+			nextTake = seen - 1;
+			skipAhead();
+		}
+
+	public:
+		Reservoir(size_t k, uint64_t seed) : k(k), gen(seed) {
+			if(k == 0) throw invalid_argument("Reservoir needs room for at least 1 item");
+			items.reserve(k);
+		}
+
+		void add(const T& item){
+			if(items.size() < k){
+				items.push_back(item);
+				if(items.size() == k){
+					nextTake = seen;
+					scheduleNext();
+				}
+			}
+			else if(seen == nextTake){
+				items[boundedRand(gen, k)] = item;
+				scheduleNext();
+			}
+			seen++;
+		}
+
+		void merge(const Reservoir& other){
+
+			if(other.k != k) throw invalid_argument("Reservoirs of different sizes can't be merged");
+
+			// Copies so taking an item doesn't change the originals
+			vector <T> mine = items, theirs = other.items;
+			uint64_t mySeen = seen, theirSeen = other.seen;
+			vector <T> merged;
+
+			while(merged.size() < k && (!mine.empty() || !theirs.empty())){
+				bool fromMine = theirs.empty() ||
+					(!mine.empty() && uniform() * (mySeen + theirSeen) < mySeen);
+				vector <T>& from = fromMine ? mine : theirs;
+				size_t pick = boundedRand(gen, from.size());
+				merged.push_back(from[pick]);
+				from[pick] = from.back();
+				from.pop_back();
+				(fromMine ? mySeen : theirSeen) -= 1;
+			}
+
+			items = merged;
+			seen += other.seen;
+			if(items.size() == k) restart();
+
+		}
+
+		const vector <T>& sample() const { return items; }
+		uint64_t itemsSeen() const { return seen; }
+
+		string serialize() const {
+			ByteWriter out;
+			out.putBytes("RSV1", 4);
+			out.put<uint64_t>(k);
+			out.put(seen);
+			out.put<uint64_t>(items.size());
+			out.putBytes(items.data(), items.size() * sizeof(T));
+			return out.result();
+		}
+
+		static Reservoir deserialize(const string& bytes, uint64_t seed){
+			ByteReader in(bytes);
+			in.expectTag("RSV1");
+			uint64_t k = in.get<uint64_t>();
+			if(k == 0 || k > bytes.size()) throw runtime_error("Reservoir size doesn't make sense");
+			Reservoir reservoir(k, seed);
+			reservoir.seen = in.get<uint64_t>();
+			uint64_t n = in.get<uint64_t>();
+			if(n > k) throw runtime_error("Reservoir holds more items than it has room for");
+			reservoir.items.resize(n);
+			in.getBytes(reservoir.items.data(), n * sizeof(T));
+			if(n == k){
+				if(reservoir.seen < k) throw runtime_error("Reservoir is full but has seen fewer than k items");
+				reservoir.restart();
+			}
+			return reservoir;
+		}
+
+};
+
+// ---------- ANIMALS ----------
+
+class Animal{
+
+	private:
+		int height;
+		int weight;
+		string name;
+
+	public:
+		Animal(int height, int weight, string name) : height(height), weight(weight), name(name) {}
+
+		int getHeight() const { return height; }
+		int getWeight() const { return weight; }
+		string getName() const { return name; }
+		const string& nameRef() const { return name; }
+
+};
+
+struct SampledAnimal{
+	int height;
+	int weight;
+};
+
+// Everything one shard of the stream builds
+struct ShardSketches{
+	HyperLogLog names;
+	TDigest weights;
+	TDigest heights;
+	Reservoir <SampledAnimal> sample;
+
+	explicit ShardSketches(uint64_t seed) : sample(1000, seed) {}
+
+	// Animals are read a batch at a time into plain arrays and the arrays
+	// are handed to the sketches
+	void addAnimals(const vector <Animal>& animals){
+
+		const size_t batch = 1024;
+		uint64_t hashes[batch];
+		double weightBatch[batch], heightBatch[batch];
+
+		for(size_t start = 0; start < animals.size(); start += batch){
+			size_t len = min(batch, animals.size() - start);
+			for(size_t i = 0; i < len; i++){
+				const Animal& animal = animals[start + i];
+				hashes[i] = hashName(animal.nameRef());
+				weightBatch[i] = animal.getWeight();
+				heightBatch[i] = animal.getHeight();
+				sample.add({animal.getHeight(), animal.getWeight()});
+			}
+			names.addHashes(hashes, len);
+			weights.addMany(weightBatch, len);
+			heights.addMany(heightBatch, len);
+		}
+
+	}
+};
+
+// Time how long it takes to run a function in milliseconds
+template <typename Func>
+double timeIt(Func func){
+
+	auto start = chrono::steady_clock::now();
+	func();
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count();
+
+}
+
+int main(int argc, char* argv[]){
+
+	// Pass the number of animals per shard, the number of shards and how
+	// many different names there can be
+	size_t perShard = (argc > 1) ? atoll(argv[1]) : 2000000;
+	int numShards = (argc > 2) ? atoi(argv[2]) : 4;
+	uint32_t numNames = (argc > 3) ? atoi(argv[3]) : 1000000;
+	if(numShards < 1) numShards = 1;
+
+	vector <string> serializedNames, serializedWeights, serializedHeights, serializedSamples;
+	unordered_set <string> exactNames;
+	vector <double> exactWeights;
+
+	double sketchTime = 0, exactTime = 0;
+
+	// ---------- EACH SHARD ----------
+	// Shards are built one after another here, but each could be on its
+	// own thread or machine since they only share the bytes they write
+
+	for(int s = 0; s < numShards; s++){
+
+		Xoshiro256pp gen = Xoshiro256pp::forStream(2024, s);
+		vector <Animal> animals;
+		animals.reserve(perShard);
+		for(size_t i = 0; i < perShard; i++){
+			// Weights are skewed so the percentiles are far apart
+			double u = ((gen() >> 11) + 0.5) / 9007199254740992.0;
+			int weight = 1 + int(-30 * log(u));
+			animals.emplace_back(20 + boundedRand(gen, 200), weight,
+				"Rex" + to_string(boundedRand(gen, numNames)));
+		}
+
+		ShardSketches sketches(100 + s);
+		sketchTime += timeIt([&]{ sketches.addAnimals(animals); });
+
+		serializedNames.push_back(sketches.names.serialize());
+		serializedWeights.push_back(sketches.weights.serialize());
+		serializedHeights.push_back(sketches.heights.serialize());
+		serializedSamples.push_back(sketches.sample.serialize());
+
+		exactTime += timeIt([&]{
+			for(const Animal& animal : animals){
+				exactNames.insert(animal.getName());
+				exactWeights.push_back(animal.getWeight());
+			}
+		});
+
+	}
+
+	// ---------- MERGING ----------
+
+	HyperLogLog names;
+	TDigest weights, heights;
+	Reservoir <SampledAnimal> sample(1000, 7);
+	size_t sketchBytes = 0;
+
+	double mergeTime = timeIt([&]{
+		for(int s = 0; s < numShards; s++){
+			names.merge(HyperLogLog::deserialize(serializedNames[s]));
+			weights.merge(TDigest::deserialize(serializedWeights[s]));
+			heights.merge(TDigest::deserialize(serializedHeights[s]));
+			sample.merge(Reservoir<SampledAnimal>::deserialize(serializedSamples[s], 200 + s));
+			sketchBytes += serializedNames[s].size() + serializedWeights[s].size() +
+				serializedHeights[s].size() + serializedSamples[s].size();
+		}
+	});
+
+	exactTime += timeIt([&]{ sort(exactWeights.begin(), exactWeights.end()); });
+
+	size_t total = perShard * numShards;
+	cout << total << " animals in " << numShards << " shards, " << sketchBytes / numShards
+		<< " bytes of sketches per shard" << endl;
+	cout << "  sketching " << sketchTime << " ms, merging " << mergeTime << " ms, exact answers "
+		<< exactTime << " ms" << endl;
+
+	double estimate = names.estimate();
+	cout << "  different names " << exactNames.size() << ", HyperLogLog says " << size_t(estimate)
+		<< " (" << (estimate / exactNames.size() - 1) * 100 << "% off)" << endl;
+
+	for(double q : {0.5, 0.9, 0.99, 0.999}){
+		double exact = exactWeights[min(total - 1, size_t(q * total))];
+		cout << "  weight " << q * 100 << "th percentile " << exact << ", TDigest says "
+			<< weights.quantile(q) << endl;
+	}
+
+	cout << "  median height " << heights.quantile(0.5) << " from " << heights.numCentroids()
+		<< " centroids" << endl;
+
+	double sampleWeight = 0;
+	for(const SampledAnimal& a : sample.sample()) sampleWeight += a.weight;
+	cout << "  " << sample.sample().size() << " sampled animals of " << sample.itemsSeen()
+		<< ", mean weight " << sampleWeight / sample.sample().size() << endl;
+
+	try{
+		TDigest::deserialize(serializedNames[0]);
+	}
+	catch(runtime_error& e){
+		cout << e.what() << endl;
+	}
+
+	// A digest whose compression got damaged on the way
+	try{
+		string damaged = serializedWeights[0];
+		double badCompression = 0.5;
+		memcpy(&damaged[4], &badCompression, sizeof(badCompression));
+		TDigest::deserialize(damaged);
+	}
+	catch(runtime_error& e){
+		cout << e.what() << endl;
+	}
+
+	// The buffers stay the same size however many numbers are added
+	{
+		TDigest one, many;
+		Xoshiro256pp gen(99);
+		size_t roomAtStart = 0;
+		vector <double> xs(1000);
+		for(int i = 0; i < 4000000; i++){
+			one.add(boundedRand(gen, 1000000));
+			if(i == 10000) roomAtStart = one.bufferRoom();
+		}
+		for(int r = 0; r < 4000; r++){
+			for(double& x : xs) x = boundedRand(gen, 1000000);
+			many.addMany(xs.data(), xs.size());
+		}
+		cout << "  TDigest buffers after 10 thousand adds " << roomAtStart << ", after 4 million "
+			<< one.bufferRoom() << " and " << many.bufferRoom() << endl;
+	}
+
+	// ---------- IS A MERGED SAMPLE STILL FAIR ----------
+	// Two halves are sampled apart, written out, read back and merged, and
+	// then as many items again are added to the merged sample. Each half
+	// should end up with a quarter of the sample and the later items with
+	// half
+
+	const uint64_t half = 50000;
+	const int trials = 20;
+	double shares[3] = {0, 0, 0};
+
+	for(int t = 0; t < trials; t++){
+		Reservoir <uint64_t> first(1000, 300 + t), second(1000, 400 + t);
+		for(uint64_t i = 0; i < half; i++) first.add(i);
+		for(uint64_t i = half; i < 2 * half; i++) second.add(i);
+
+		Reservoir <uint64_t> merged = Reservoir<uint64_t>::deserialize(first.serialize(), 500 + t);
+		merged.merge(Reservoir<uint64_t>::deserialize(second.serialize(), 600 + t));
+		for(uint64_t i = 2 * half; i < 4 * half; i++) merged.add(i);
+
+		for(uint64_t item : merged.sample()) shares[min<uint64_t>(item / half, 2)] += 1.0 / (1000 * trials);
+	}
+
+	cout << "Shares of a merged sample: first half " << shares[0] << ", second half " << shares[1]
+		<< ", added after the merge " << shares[2] << " (should be 0.25, 0.25 and 0.5)" << endl;
+
+	return 0;
+}
@@ -0,0 +1,277 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include "Random.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// The Heaviest 100 Animals
+// To find the 100 heaviest animals out of millions we don't need to sort
+// them all. TopK keeps the best k seen so far in a min heap, so the
+// lightest of the best is always on top. A new animal only gets in if it
+// beats that one, and then it replaces it in O(log k)
+//
+// After the first few thousand animals almost nothing beats the top of
+// the heap. offerBatch compares 8 weights at a time against it with AVX2
+// and only looks closer at the ones that pass, so most animals never
+// touch the heap at all
+//
+// Equal weights go to the animal with the smaller id. That makes the
+// answer the same no matter how the animals are split between threads
+// parallelTopAnimals gives each thread its own TopK and merges them at the
+// end
+
+struct Ranked{
+	int key;
+	uint64_t id;
+};
+
+// true if a should be ranked above b
+inline bool rankedAbove(const Ranked& a, const Ranked& b){
+	return a.key > b.key || (a.key == b.key && a.id < b.id);
+}
+
+class TopK{
+
+	private:
+		size_t k;
+		// The heap keeps the worst of the best k at heap[0]
+		vector <Ranked> heap;
+
+	public:
+		explicit TopK(size_t k) : k(k) {
+			if(k == 0) throw invalid_argument("TopK needs k of at least 1");
+			heap.reserve(k);
+		}
+
+		// Anything with a smaller key can't get in. Until the heap is
+		// full everything gets in
+		int threshold() const {
+			return heap.size() < k ? numeric_limits<int>::min() : heap[0].key;
+		}
+
+		void offer(int key, uint64_t id){
+			Ranked item{key, id};
+			if(heap.size() < k){
+				heap.push_back(item);
+				push_heap(heap.begin(), heap.end(), rankedAbove);
+			}
+			else if(rankedAbove(item, heap[0])){
+				pop_heap(heap.begin(), heap.end(), rankedAbove);
+				heap.back() = item;
+				push_heap(heap.begin(), heap.end(), rankedAbove);
+			}
+		}
+
+		// keys[i] belongs to the animal with id firstId + i
+		void offerBatch(const int* keys, size_t n, uint64_t firstId){
+
+			size_t i = 0;
+
+#ifdef __AVX2__
+			while(i < n && heap.size() < k){
+				offer(keys[i], firstId + i);
+				i++;
+			}
+
+			// Keys equal to the threshold can still win on id, so the
+			// test is key > threshold - 1
+			int limit = threshold();
+			__m256i bar = _mm256_set1_epi32(limit == numeric_limits<int>::min() ? limit : limit - 1);
+
+			for(; i + 8 <= n; i += 8){
+				__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+				unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(x, bar)));
+				if(mask == 0) continue;
+
+				for(; mask; mask &= mask - 1){
+					int lane = __builtin_ctz(mask);
+					offer(keys[i + lane], firstId + i + lane);
+				}
+
+				if(threshold() != limit){
+					limit = threshold();
+					bar = _mm256_set1_epi32(limit - 1);
+				}
+			}
+#endif
+
+			for(; i < n; i++) offer(keys[i], firstId + i);
+
+		}
+
+		void merge(const TopK& other){
+			for(const Ranked& item : other.heap) offer(item.key, item.id);
+		}
+
+		// Best first
+		vector <Ranked> sorted() const {
+			vector <Ranked> result = heap;
+			sort(result.begin(), result.end(), rankedAbove);
+			return result;
+		}
+
+};
+
+// ---------- ANIMALS ----------
+
+class Animal{
+
+	private:
+		int height;
+		int weight;
+		string name;
+
+	public:
+		Animal(int height, int weight, string name) : height(height), weight(weight), name(name) {}
+
+		int getHeight() const { return height; }
+		int getWeight() const { return weight; }
+		string getName() const { return name; }
+
+};
+
+// The k best animals in [start, end) by getKey. Keys are copied out a
+// batch at a time so the SIMD filter can read them from a plain array
+template <typename GetKey>
+TopK topAnimals(const vector <Animal>& animals, size_t start, size_t end, size_t k, GetKey getKey){
+
+	TopK best(k);
+	const size_t batch = 1024;
+	int keys[batch];
+
+	for(size_t b = start; b < end; b += batch){
+		size_t len = min(batch, end - b);
+		for(size_t i = 0; i < len; i++) keys[i] = getKey(animals[b + i]);
+		best.offerBatch(keys, len, b);
+	}
+
+	return best;
+
+}
+
+template <typename GetKey>
+TopK parallelTopAnimals(const vector <Animal>& animals, size_t k, GetKey getKey, unsigned numThreads){
+
+	vector <TopK> results(numThreads, TopK(k));
+	vector <thread> workers;
+	size_t slice = (animals.size() + numThreads - 1) / numThreads;
+
+	for(unsigned t = 0; t < numThreads; t++){
+		size_t start = min(animals.size(), t * slice);
+		size_t end = min(animals.size(), start + slice);
+		workers.emplace_back([&, t, start, end]{ results[t] = topAnimals(animals, start, end, k, getKey); });
+	}
+
+	for(thread& worker : workers) worker.join();
+
+	for(unsigned t = 1; t < numThreads; t++) results[0].merge(results[t]);
+	return results[0];
+
+}
+
+// Time how long it takes to run a function in milliseconds
+template <typename Func>
+double timeIt(Func func){
+
+	auto start = chrono::steady_clock::now();
+	func();
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count();
+
+}
+
+int main(int argc, char* argv[]){
+
+	// Pass the number of animals, k and the number of threads
+	size_t n = (argc > 1) ? atoll(argv[1]) : 10000000;
+	size_t k = (argc > 2) ? atoll(argv[2]) : 100;
+	unsigned numThreads = (argc > 3) ? atoi(argv[3]) : thread::hardware_concurrency();
+	if(numThreads == 0) numThreads = 1;
+
+	Xoshiro256pp gen(2024);
+	vector <Animal> animals;
+	animals.reserve(n);
+	for(size_t i = 0; i < n; i++)
+		animals.emplace_back(20 + boundedRand(gen, 200), 1 + boundedRand(gen, 1000000), "Rex");
+
+	auto byWeight = [](const Animal& a){ return a.getWeight(); };
+	auto byHeight = [](const Animal& a){ return a.getHeight(); };
+
+	// ---------- SORTING EVERYTHING ----------
+
+	vector <Ranked> everything;
+	double sortTime = timeIt([&]{
+		everything.resize(n);
+		for(size_t i = 0; i < n; i++) everything[i] = {animals[i].getWeight(), i};
+		sort(everything.begin(), everything.end(), rankedAbove);
+	});
+
+	// ---------- HEAP WITHOUT THE FILTER ----------
+
+	TopK plainHeap(k);
+	double heapTime = timeIt([&]{
+		for(size_t i = 0; i < n; i++) plainHeap.offer(animals[i].getWeight(), i);
+	});
+
+	// ---------- FILTERED AND PARALLEL ----------
+
+	TopK filtered(k);
+	double filterTime = timeIt([&]{ filtered = topAnimals(animals, 0, n, k, byWeight); });
+
+	TopK parallel(k);
+	double parallelTime = timeIt([&]{ parallel = parallelTopAnimals(animals, k, byWeight, numThreads); });
+
+	// When the weights are already a column there is no copying and the
+	// filter is all that is left
+	vector <int> weightColumn(n);
+	for(size_t i = 0; i < n; i++) weightColumn[i] = animals[i].getWeight();
+
+	TopK columnHeap(k), columnFiltered(k);
+	double columnHeapTime = timeIt([&]{
+		for(size_t i = 0; i < n; i++) columnHeap.offer(weightColumn[i], i);
+	});
+	double columnFilterTime = timeIt([&]{ columnFiltered.offerBatch(weightColumn.data(), n, 0); });
+
+	auto same = [&](const TopK& top){
+		vector <Ranked> result = top.sorted();
+		if(result.size() != min(k, n)) return false;
+		for(size_t i = 0; i < result.size(); i++)
+			if(result[i].key != everything[i].key || result[i].id != everything[i].id) return false;
+		return true;
+	};
+
+	cout << "Top " << k << " of " << n << " animals by weight" << endl;
+	cout << "  sort everything   " << sortTime << " ms" << endl;
+	cout << "  heap              " << heapTime << " ms, same answer " << boolalpha << same(plainHeap) << endl;
+	cout << "  SIMD filtered     " << filterTime << " ms, same answer " << same(filtered) << endl;
+	cout << "  " << numThreads << " threads         " << parallelTime << " ms, same answer "
+		<< same(parallel) << endl;
+
+	cout << "  weight column heap " << columnHeapTime << " ms, SIMD filtered " << columnFilterTime
+		<< " ms, same answers " << (same(columnHeap) && same(columnFiltered)) << endl;
+
+	vector <Ranked> heaviest = filtered.sorted();
+	cout << "  heaviest " << heaviest[0].key << " (animal " << heaviest[0].id << "), "
+		<< k << "th " << heaviest.back().key << endl;
+
+	// Heights only go from 20 to 219 so there are lots of ties, which are
+	// broken by id
+	vector <Ranked> tallest = parallelTopAnimals(animals, 5, byHeight, numThreads).sorted();
+	cout << "Tallest 5 :";
+	for(const Ranked& r : tallest) cout << " " << r.key << " (animal " << r.id << ")";
+	cout << endl;
+
+	return 0;
+}
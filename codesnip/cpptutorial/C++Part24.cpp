@@ -0,0 +1,284 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include "Random.h"
+
+using namespace std;
+
+// Radix Sorting Animals
+// sort(animals.begin(), animals.end(), byHeight) compares animals two at a
+// time about n log n times, calls the getters every time and moves whole
+// Animal objects with their strings around
+// A radix sort never compares. It looks at the key 11 bits at a time,
+// starting with the lowest 11. Each pass counts how many keys have each of
+// the 2048 possible digits, works out where each digit's run starts, and
+// copies every key to its place. Keys with the same digit keep their order
+// (the sort is stable), so after the pass on the highest digit everything
+// is in order. A 32 bit key takes 3 passes, however many keys there are
+//
+// A pass is skipped when every key has the same digit there. Heights all
+// fit in 11 bits, so sorting by height is a single pass
+//
+// With several threads each one counts the digits in its own slice. The
+// counts say exactly where each thread's keys for each digit go, so all of
+// them can copy at once without getting in each other's way, and keys
+// from earlier slices still land first
+//
+// Animals are sorted by pulling out (key, row) pairs, sorting those and
+// then moving each animal once to where its row says
+
+const int digitBits = 11;
+const size_t numDigits = size_t(1) << digitBits;
+
+// Signed ints sort in the right order as unsigned ones once the sign bit
+// is flipped
+inline uint32_t radixKey(int value){ return uint32_t(value) ^ 0x80000000u; }
+
+struct KeyRow{
+	uint32_t key;
+	uint32_t row;
+};
+
+inline uint32_t keyOf(uint32_t key){ return key; }
+inline uint32_t keyOf(const KeyRow& item){ return item.key; }
+
+// Runs func(t, start, end) on numThreads threads, one slice each
+template <typename Func>
+void onSlices(size_t n, unsigned numThreads, Func func){
+
+	size_t slice = (n + numThreads - 1) / numThreads;
+
+	if(numThreads == 1){
+		func(0, 0, n);
+		return;
+	}
+
+	vector <thread> workers;
+	for(unsigned t = 0; t < numThreads; t++){
+		size_t start = min(n, t * slice);
+		size_t end = min(n, start + slice);
+		workers.emplace_back(func, t, start, end);
+	}
+	for(thread& worker : workers) worker.join();
+
+}
+
+// Sorts data by keyOf using temp as the second buffer. Both hold n items
+template <typename T>
+void radixSort(vector <T>& data, unsigned numThreads = 1){
+
+	size_t n = data.size();
+	if(numThreads == 0) numThreads = 1;
+	if(n < 2) return;
+
+	vector <T> temp(n);
+	T* from = data.data();
+	T* to = temp.data();
+
+	// Two cache lines of items per digit
+	const size_t perLine = sizeof(T) < 128 ? 128 / sizeof(T) : 1;
+
+	// counts[t][digit] for the current pass
+	vector <vector<size_t>> counts(numThreads, vector<size_t>(numDigits));
+
+	for(int shift = 0; shift < 32; shift += digitBits){
+
+		onSlices(n, numThreads, [&](unsigned t, size_t start, size_t end){
+			vector <size_t>& count = counts[t];
+			fill(count.begin(), count.end(), 0);
+			for(size_t i = start; i < end; i++) count[(keyOf(from[i]) >> shift) & (numDigits - 1)]++;
+		});
+
+		// If one digit has every key this pass wouldn't move anything
+		bool allSame = false;
+		for(size_t d = 0; d < numDigits && !allSame; d++){
+			size_t total = 0;
+			for(unsigned t = 0; t < numThreads; t++) total += counts[t][d];
+			if(total == n) allSame = true;
+			else if(total != 0) break;
+		}
+		if(allSame) continue;
+
+		// Turn counts into where each thread starts writing each digit
+		// Digit by digit, and within a digit thread by thread, which
+		// keeps the sort stable
+		size_t next = 0;
+		for(size_t d = 0; d < numDigits; d++){
+			for(unsigned t = 0; t < numThreads; t++){
+				size_t count = counts[t][d];
+				counts[t][d] = next;
+				next += count;
+			}
+		}
+
+		// Writing straight to 2048 places spread over the whole array
+		// misses the cache and the TLB on nearly every write. Instead each
+		// digit gets a small buffer of a couple of cache lines and a full
+		// buffer is copied out in one go
+		onSlices(n, numThreads, [&](unsigned t, size_t start, size_t end){
+			vector <size_t>& place = counts[t];
+			vector <T> buffer(numDigits * perLine);
+			vector <uint32_t> filled(numDigits, 0);
+
+			for(size_t i = start; i < end; i++){
+				size_t d = (keyOf(from[i]) >> shift) & (numDigits - 1);
+				T* line = &buffer[d * perLine];
+				line[filled[d]++] = from[i];
+				if(filled[d] == perLine){
+					copy(line, line + perLine, to + place[d]);
+					place[d] += perLine;
+					filled[d] = 0;
+				}
+			}
+
+			for(size_t d = 0; d < numDigits; d++)
+				copy(&buffer[d * perLine], &buffer[d * perLine] + filled[d], to + place[d]);
+		});
+
+		swap(from, to);
+
+	}
+
+	if(from != data.data()) data.swap(temp);
+
+}
+
+// ---------- ANIMALS ----------
+
+class Animal{
+
+	private:
+		int height;
+		int weight;
+		string name;
+
+	public:
+		Animal() : height(0), weight(0) {}
+		Animal(int height, int weight, string name) : height(height), weight(weight), name(name) {}
+
+		int getHeight() const { return height; }
+		int getWeight() const { return weight; }
+		string getName() const { return name; }
+		const string& nameRef() const { return name; }
+
+};
+
+// The rows of animals in sorted order by getKey. Equal keys keep their
+// original order
+template <typename GetKey>
+vector <uint32_t> sortedOrder(const vector <Animal>& animals, GetKey getKey, unsigned numThreads){
+
+	vector <KeyRow> pairs(animals.size());
+	onSlices(animals.size(), numThreads, [&](unsigned, size_t start, size_t end){
+		for(size_t i = start; i < end; i++) pairs[i] = {radixKey(getKey(animals[i])), uint32_t(i)};
+	});
+
+	radixSort(pairs, numThreads);
+
+	vector <uint32_t> order(pairs.size());
+	for(size_t i = 0; i < pairs.size(); i++) order[i] = pairs[i].row;
+	return order;
+
+}
+
+// items[order[0]] comes first, then items[order[1]] and so on. Each item
+// is moved once into a new vector
+template <typename T>
+void applyOrder(vector <T>& items, const vector <uint32_t>& order, unsigned numThreads){
+
+	vector <T> result(items.size());
+	onSlices(items.size(), numThreads, [&](unsigned, size_t start, size_t end){
+		for(size_t i = start; i < end; i++) result[i] = move(items[order[i]]);
+	});
+	items.swap(result);
+
+}
+
+// Time how long it takes to run a function in milliseconds
+template <typename Func>
+double timeIt(Func func){
+
+	auto start = chrono::steady_clock::now();
+	func();
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count();
+
+}
+
+int main(int argc, char* argv[]){
+
+	// Pass the number of keys, the number of animals and the number of threads
+	size_t numKeys = (argc > 1) ? atoll(argv[1]) : 100000000;
+	size_t numAnimals = (argc > 2) ? atoll(argv[2]) : 10000000;
+	unsigned numThreads = (argc > 3) ? atoi(argv[3]) : thread::hardware_concurrency();
+	if(numThreads == 0) numThreads = 1;
+
+	Xoshiro256pp gen(2024);
+
+	// ---------- KEYS ONLY ----------
+	{
+		vector <uint32_t> keys(numKeys);
+		for(uint32_t& key : keys) key = uint32_t(gen());
+		vector <uint32_t> copy = keys;
+
+		double stdTime = timeIt([&]{ sort(copy.begin(), copy.end()); });
+		double radixTime = timeIt([&]{ radixSort(keys, numThreads); });
+
+		cout << "Sorting " << numKeys << " 32 bit keys" << endl;
+		cout << "  std::sort   " << stdTime << " ms" << endl;
+		cout << "  radixSort   " << radixTime << " ms (" << stdTime / radixTime << "x faster), same order "
+			<< boolalpha << (keys == copy) << endl;
+	}
+
+	// ---------- ANIMALS ----------
+
+	vector <Animal> animals;
+	animals.reserve(numAnimals);
+	for(size_t i = 0; i < numAnimals; i++)
+		animals.emplace_back(20 + boundedRand(gen, 200), 1 + boundedRand(gen, 1000000),
+			"Rex" + to_string(i % 1000));
+
+	vector <Animal> byStd = animals;
+
+	auto height = [](const Animal& a){ return a.getHeight(); };
+	auto weight = [](const Animal& a){ return a.getWeight(); };
+
+	double stdTime = timeIt([&]{
+		stable_sort(byStd.begin(), byStd.end(),
+			[](const Animal& a, const Animal& b){ return a.getWeight() < b.getWeight(); });
+	});
+
+	vector <uint32_t> order;
+	double orderTime = timeIt([&]{ order = sortedOrder(animals, weight, numThreads); });
+	double moveTime = timeIt([&]{ applyOrder(animals, order, numThreads); });
+
+	bool same = true;
+	for(size_t i = 0; i < numAnimals; i++)
+		same = same && animals[i].getWeight() == byStd[i].getWeight() && animals[i].nameRef() == byStd[i].nameRef();
+
+	cout << "Sorting " << numAnimals << " animals by weight on " << numThreads << " threads" << endl;
+	cout << "  std::stable_sort      " << stdTime << " ms" << endl;
+	cout << "  radix order + moving  " << orderTime << " + " << moveTime << " ms ("
+		<< stdTime / (orderTime + moveTime) << "x faster), same order " << same << endl;
+
+	// Heights fit in one 11 bit digit so only one pass runs. Equal
+	// heights stay in weight order because the sort is stable
+	double heightTime = timeIt([&]{ order = sortedOrder(animals, height, numThreads); });
+
+	bool stable = true;
+	for(size_t i = 1; i < numAnimals; i++){
+		const Animal& a = animals[order[i - 1]];
+		const Animal& b = animals[order[i]];
+		stable = stable && (a.getHeight() < b.getHeight() ||
+			(a.getHeight() == b.getHeight() && order[i - 1] < order[i]));
+	}
+
+	cout << "  order by height " << heightTime << " ms, stable " << stable << endl;
+
+	return 0;
+}
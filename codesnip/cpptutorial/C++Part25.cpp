@@ -0,0 +1,423 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include "Random.h"
+
+using namespace std;
+
+// Grouping Dogs by Sound
+// "How many dogs say Woof and what do they weigh on average?" is a group by.
+// Every dog is looked up in a table keyed on its sound and the count and
+// total weight for that sound go up
+//
+// GroupTable is a hash table made for this. The slots are one flat array
+// and a key that lands on a full slot just tries the next one (linear
+// probing), so a lookup reads memory that sits together. The slot keeps the
+// whole hash, so the strings only get compared when the hashes match
+//
+// There are two ways to split the work between threads
+//
+// Pre aggregating: each thread groups its own slice of dogs into its own
+// table and then the tables are merged. With a handful of sounds each table
+// stays tiny and in the cache, and the merge only touches a few groups
+//
+// Partitioning: with millions of different names every table is huge, each
+// lookup misses the cache and the merge has as many groups as there are
+// rows. Instead the rows are first split by the top 8 bits of their hash
+// into 256 partitions, the same way a radix sort pass splits keys. A name
+// always lands in the same partition, so each partition can be grouped on
+// its own into a table small enough for the cache, and nothing needs merging
+//
+// groupBy picks one by grouping a sample of the rows first. If the sample
+// already has lots of different keys it partitions
+
+// FNV-1a over the bytes followed by a finisher that mixes the high bits
+// into the low ones
+uint64_t hashName(const string& name){
+
+	uint64_t h = 0xcbf29ce484222325ULL;
+	for(unsigned char c : name){
+		h ^= c;
+		h *= 0x100000001b3ULL;
+	}
+
+	h ^= h >> 30;
+	h *= 0xbf58476d1ce4e5b9ULL;
+	h ^= h >> 27;
+	h *= 0x94d049bb133111ebULL;
+	return h ^ (h >> 31);
+
+}
+
+struct Group{
+	string key;
+	uint64_t hash;
+	long long count;
+	long long weightSum;
+
+	double averageWeight() const { return count ? double(weightSum) / count : 0; }
+};
+
+class GroupTable{
+
+	private:
+		// slots[i] is 1 + the index into groups, 0 for an empty slot
+		vector <uint32_t> slots;
+		vector <uint64_t> slotHashes;
+		vector <Group> groups;
+		size_t mask;
+
+		// Doubling only moves slots. The groups stay where they are
+		void grow(){
+			size_t capacity = slots.size() * 2;
+			slots.assign(capacity, 0);
+			slotHashes.assign(capacity, 0);
+			mask = capacity - 1;
+			for(size_t g = 0; g < groups.size(); g++){
+				size_t i = groups[g].hash & mask;
+				while(slots[i] != 0) i = (i + 1) & mask;
+				slots[i] = g + 1;
+				slotHashes[i] = groups[g].hash;
+			}
+		}
+
+	public:
+		explicit GroupTable(size_t expectedGroups = 16) {
+			size_t capacity = 16;
+			while(capacity < expectedGroups * 2) capacity *= 2;
+			slots.assign(capacity, 0);
+			slotHashes.assign(capacity, 0);
+			mask = capacity - 1;
+			groups.reserve(expectedGroups);
+		}
+
+		// The group for key, made empty if it isn't there yet
+		Group& groupFor(uint64_t hash, const string& key){
+
+			size_t i = hash & mask;
+			while(slots[i] != 0){
+				if(slotHashes[i] == hash){
+					Group& group = groups[slots[i] - 1];
+					if(group.key == key) return group;
+				}
+				i = (i + 1) & mask;
+			}
+
+			// Kept at most 3/4 full so probes stay short
+			if((groups.size() + 1) * 4 > slots.size() * 3){
+				grow();
+				return groupFor(hash, key);
+			}
+
+			groups.push_back({key, hash, 0, 0});
+			slots[i] = groups.size();
+			slotHashes[i] = hash;
+			return groups.back();
+
+		}
+
+		void add(uint64_t hash, const string& key, int weight){
+			Group& group = groupFor(hash, key);
+			group.count++;
+			group.weightSum += weight;
+		}
+
+		void merge(const GroupTable& other){
+			for(const Group& theirs : other.groups){
+				Group& ours = groupFor(theirs.hash, theirs.key);
+				ours.count += theirs.count;
+				ours.weightSum += theirs.weightSum;
+			}
+		}
+
+		size_t size() const { return groups.size(); }
+		const vector <Group>& result() const { return groups; }
+		vector <Group>& result() { return groups; }
+
+};
+
+// Runs func(t, start, end) on numThreads threads, one slice each
+template <typename Func>
+void onSlices(size_t n, unsigned numThreads, Func func){
+
+	size_t slice = (n + numThreads - 1) / numThreads;
+
+	if(numThreads == 1){
+		func(0, 0, n);
+		return;
+	}
+
+	vector <thread> workers;
+	for(unsigned t = 0; t < numThreads; t++){
+		size_t start = min(n, t * slice);
+		size_t end = min(n, start + slice);
+		workers.emplace_back(func, t, start, end);
+	}
+	for(thread& worker : workers) worker.join();
+
+}
+
+enum class GroupStrategy { Auto, PreAggregate, Partitioned };
+
+const char* strategyName(GroupStrategy strategy){
+	switch(strategy){
+		case GroupStrategy::PreAggregate: return "pre aggregated";
+		case GroupStrategy::Partitioned: return "partitioned";
+		default: return "auto";
+	}
+}
+
+const int partitionBits = 8;
+const size_t numPartitions = size_t(1) << partitionBits;
+
+// Auto partitions when a sample of this many rows has more than
+// sampleRows / 16 different keys
+const size_t sampleRows = 65536;
+
+template <typename Row, typename GetKey>
+GroupStrategy chooseStrategy(const vector <Row>& rows, GetKey getKey){
+
+	GroupTable sample;
+	size_t n = min(rows.size(), sampleRows);
+	for(size_t i = 0; i < n; i++){
+		const string& key = getKey(rows[i]);
+		sample.groupFor(hashName(key), key);
+	}
+	return sample.size() > sampleRows / 16 ? GroupStrategy::Partitioned : GroupStrategy::PreAggregate;
+
+}
+
+template <typename Row, typename GetKey>
+vector <Group> preAggregate(const vector <Row>& rows, GetKey getKey, unsigned numThreads){
+
+	vector <GroupTable> tables(numThreads);
+
+	onSlices(rows.size(), numThreads, [&](unsigned t, size_t start, size_t end){
+		GroupTable& table = tables[t];
+		for(size_t i = start; i < end; i++){
+			const string& key = getKey(rows[i]);
+			table.add(hashName(key), key, rows[i].getWeight());
+		}
+	});
+
+	for(unsigned t = 1; t < numThreads; t++) tables[0].merge(tables[t]);
+	return move(tables[0].result());
+
+}
+
+struct HashedRow{
+	uint64_t hash;
+	uint32_t row;
+};
+
+template <typename Row, typename GetKey>
+vector <Group> partitioned(const vector <Row>& rows, GetKey getKey, unsigned numThreads){
+
+	size_t n = rows.size();
+	vector <uint64_t> hashes(n);
+	vector <vector<size_t>> counts(numThreads, vector<size_t>(numPartitions, 0));
+
+	// Hash every row once and count how many go to each partition
+	onSlices(n, numThreads, [&](unsigned t, size_t start, size_t end){
+		vector <size_t>& count = counts[t];
+		for(size_t i = start; i < end; i++){
+			hashes[i] = hashName(getKey(rows[i]));
+			count[hashes[i] >> (64 - partitionBits)]++;
+		}
+	});
+
+	// Where each thread starts writing each partition, partition by
+	// partition so each partition ends up in one piece
+	vector <size_t> partitionStart(numPartitions + 1, 0);
+	size_t next = 0;
+	for(size_t p = 0; p < numPartitions; p++){
+		partitionStart[p] = next;
+		for(unsigned t = 0; t < numThreads; t++){
+			size_t count = counts[t][p];
+			counts[t][p] = next;
+			next += count;
+		}
+	}
+	partitionStart[numPartitions] = next;
+
+	vector <HashedRow> split(n);
+	onSlices(n, numThreads, [&](unsigned t, size_t start, size_t end){
+		vector <size_t>& place = counts[t];
+		for(size_t i = start; i < end; i++)
+			split[place[hashes[i] >> (64 - partitionBits)]++] = {hashes[i], uint32_t(i)};
+	});
+
+	// Threads take partitions until there are none left. Each partition
+	// has keys no other partition has, so its table is already final
+	vector <GroupTable> tables(numPartitions, GroupTable(0));
+	atomic <size_t> nextPartition(0);
+
+	onSlices(numThreads, numThreads, [&](unsigned, size_t, size_t){
+		for(size_t p; (p = nextPartition.fetch_add(1)) < numPartitions;){
+			GroupTable table((partitionStart[p + 1] - partitionStart[p]) / 4);
+			for(size_t i = partitionStart[p]; i < partitionStart[p + 1]; i++){
+				const Row& row = rows[split[i].row];
+				table.add(split[i].hash, getKey(row), row.getWeight());
+			}
+			tables[p] = move(table);
+		}
+	});
+
+	size_t total = 0;
+	for(const GroupTable& table : tables) total += table.size();
+
+	vector <Group> result;
+	result.reserve(total);
+	for(GroupTable& table : tables)
+		for(Group& group : table.result()) result.push_back(move(group));
+	return result;
+
+}
+
+// Count and total weight of rows for each key. getKey returns a const
+// string& and every row has getWeight(). Groups come back in no order
+template <typename Row, typename GetKey>
+vector <Group> groupBy(const vector <Row>& rows, GetKey getKey, unsigned numThreads = 1,
+	GroupStrategy strategy = GroupStrategy::Auto){
+
+	if(numThreads == 0) numThreads = 1;
+	if(strategy == GroupStrategy::Auto) strategy = chooseStrategy(rows, getKey);
+
+	if(strategy == GroupStrategy::Partitioned) return partitioned(rows, getKey, numThreads);
+	return preAggregate(rows, getKey, numThreads);
+
+}
+
+// ---------- ANIMALS ----------
+// The Part1 Animal and Dog
+
+class Animal{
+
+	private:
+		int height;
+		int weight;
+		string name;
+
+	public:
+		Animal(int height, int weight, string name) : height(height), weight(weight), name(name) {}
+
+		int getHeight() const { return height; }
+		int getWeight() const { return weight; }
+		string getName() const { return name; }
+		const string& nameRef() const { return name; }
+
+};
+
+class Dog : public Animal{
+
+	private:
+		string sound = "Woof";
+
+	public:
+		Dog(int height, int weight, string name, string bark) : Animal(height, weight, name), sound(bark) {}
+
+		string getSound() const { return sound; }
+		const string& soundRef() const { return sound; }
+
+};
+
+// Time how long it takes to run a function in milliseconds
+template <typename Func>
+double timeIt(Func func){
+
+	auto start = chrono::steady_clock::now();
+	func();
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count();
+
+}
+
+// Times unordered_map on one thread and each strategy on numThreads
+// threads, checks they all agree and prints rows per second per core
+template <typename GetKey>
+void compareGroupings(const string& label, const vector <Dog>& dogs, GetKey getKey, unsigned numThreads){
+
+	size_t n = dogs.size();
+
+	unordered_map <string, pair<long long, long long>> baseline;
+	double mapTime = timeIt([&]{
+		for(const Dog& dog : dogs){
+			auto& totals = baseline[getKey(dog)];
+			totals.first++;
+			totals.second += dog.getWeight();
+		}
+	});
+
+	auto matches = [&](const vector <Group>& groups){
+		if(groups.size() != baseline.size()) return false;
+		for(const Group& group : groups){
+			auto found = baseline.find(group.key);
+			if(found == baseline.end() || found -> second.first != group.count ||
+				found -> second.second != group.weightSum) return false;
+		}
+		return true;
+	};
+
+	auto rate = [&](double ms, unsigned threads){ return n / (ms / 1000) / threads / 1e6; };
+
+	cout << "Grouping " << n << " dogs by " << label << " into " << baseline.size() << " groups, auto picks "
+		<< strategyName(chooseStrategy(dogs, getKey)) << endl;
+	cout << "  unordered_map   " << mapTime << " ms, " << rate(mapTime, 1) << "M rows/s/core" << endl;
+
+	for(GroupStrategy strategy : {GroupStrategy::PreAggregate, GroupStrategy::Partitioned}){
+		vector <Group> groups;
+		double ms = timeIt([&]{ groups = groupBy(dogs, getKey, numThreads, strategy); });
+		cout << "  " << strategyName(strategy) << (strategy == GroupStrategy::Partitioned ? "     " : "  ")
+			<< ms << " ms, " << rate(ms, numThreads) << "M rows/s/core on " << numThreads
+			<< " threads, same groups " << boolalpha << matches(groups) << endl;
+	}
+
+}
+
+int main(int argc, char* argv[]){
+
+	// Pass the number of dogs, the number of different names and the
+	// number of threads
+	size_t n = (argc > 1) ? atoll(argv[1]) : 10000000;
+	size_t numNames = (argc > 2) ? atoll(argv[2]) : 2000000;
+	unsigned numThreads = (argc > 3) ? atoi(argv[3]) : thread::hardware_concurrency();
+	if(numThreads == 0) numThreads = 1;
+	if(numNames == 0) numNames = 1;
+
+	const vector <string> sounds = {"Woof", "Bark", "Yip", "Arf", "Ruff", "Bow Wow", "Grr", "Awoo"};
+
+	Xoshiro256pp gen(2024);
+	vector <Dog> dogs;
+	dogs.reserve(n);
+	for(size_t i = 0; i < n; i++){
+		const string& sound = sounds[boundedRand(gen, sounds.size())];
+		dogs.emplace_back(20 + boundedRand(gen, 100), 5 + boundedRand(gen, 60) + sound.size(),
+			"Rex" + to_string(boundedRand(gen, numNames)), sound);
+	}
+
+	auto bySound = [](const Dog& dog) -> const string& { return dog.soundRef(); };
+	auto byName = [](const Dog& dog) -> const string& { return dog.nameRef(); };
+
+	// ---------- COUNT AND AVERAGE WEIGHT PER SOUND ----------
+
+	vector <Group> perSound = groupBy(dogs, bySound, numThreads);
+	sort(perSound.begin(), perSound.end(), [](const Group& a, const Group& b){ return a.count > b.count; });
+
+	cout << "Dogs by sound" << endl;
+	for(const Group& group : perSound)
+		cout << "  " << group.key << " " << group.count << " dogs, average weight " << group.averageWeight() << endl;
+
+	// ---------- TIMINGS ----------
+
+	compareGroupings("sound", dogs, bySound, numThreads);
+	compareGroupings("name", dogs, byName, numThreads);
+
+	return 0;
+}
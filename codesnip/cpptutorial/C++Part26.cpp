@@ -0,0 +1,460 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <stdexcept>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include "Random.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// Joining Animals to Their Owners
+// Each animal has the id of its owner and the owners are in their own
+// table. Finding every animal's owner with two nested loops compares every
+// animal with every owner, which is hopeless with millions of each
+//
+// A hash join puts the smaller table (the build side, owners) in a hash
+// table and then looks up every row of the bigger one (the probe side,
+// animals) in it. That is one lookup per animal, but once the hash table is
+// bigger than the cache every lookup is a cache miss
+//
+// So first both tables are split into partitions by some bits of the hash
+// of the key, the same way a radix sort pass splits keys. An owner and its
+// animals always land in partitions with the same number, so partition p
+// of the owners only needs to be joined with partition p of the animals.
+// There are enough partitions that each one's hash table fits in the cache
+//
+// The hash table for a partition keeps the keys of each bucket next to
+// each other, so a lookup compares the key against 8 keys at a time with
+// AVX2
+//
+// When the owners don't fit in the memory we are allowed to use, both
+// tables are first split into partitions on disk by different hash bits
+// (a Grace hash join). Each pair of files is read back and joined in
+// memory on its own
+
+// A row reduced to what the join needs: the key and 32 bits of payload,
+// usually the row number in the real table
+struct Tuple{
+	uint32_t key;
+	uint32_t payload;
+};
+
+// Finisher from SplitMix64. Every bit of the result depends on every bit
+// of the key, so any group of bits can be used as a partition number
+inline uint64_t hashKey(uint32_t key){
+	uint64_t h = key;
+	h ^= h >> 30;
+	h *= 0xbf58476d1ce4e5b9ULL;
+	h ^= h >> 27;
+	h *= 0x94d049bb133111ebULL;
+	return h ^ (h >> 31);
+}
+
+// Which bits are used for what. Spill files use the top 8, memory
+// partitions the bits from 32 up and buckets inside a partition the low 32
+const int maxSpillBits = 8;
+const int partitionShift = 32;
+const int maxPartitionBits = 14;
+
+inline size_t spillOf(uint64_t h, int bits){ return bits == 0 ? 0 : h >> (64 - bits); }
+inline size_t partitionOf(uint64_t h, int bits){ return (h >> partitionShift) & ((size_t(1) << bits) - 1); }
+
+// Runs func(t, start, end) on numThreads threads, one slice each
+template <typename Func>
+void onSlices(size_t n, unsigned numThreads, Func func){
+
+	size_t slice = (n + numThreads - 1) / numThreads;
+
+	if(numThreads == 1){
+		func(0, 0, n);
+		return;
+	}
+
+	vector <thread> workers;
+	for(unsigned t = 0; t < numThreads; t++){
+		size_t start = min(n, t * slice);
+		size_t end = min(n, start + slice);
+		workers.emplace_back(func, t, start, end);
+	}
+	for(thread& worker : workers) worker.join();
+
+}
+
+// Tuples split into 2^bits partitions. Partition p is
+// rows[start[p]] up to rows[start[p + 1]]
+struct Partitioned{
+	vector <Tuple> rows;
+	vector <size_t> start;
+};
+
+Partitioned partition(const vector <Tuple>& in, int bits, unsigned numThreads){
+
+	size_t n = in.size();
+	size_t numParts = size_t(1) << bits;
+	vector <vector<size_t>> counts(numThreads, vector<size_t>(numParts, 0));
+
+	onSlices(n, numThreads, [&](unsigned t, size_t start, size_t end){
+		vector <size_t>& count = counts[t];
+		for(size_t i = start; i < end; i++) count[partitionOf(hashKey(in[i].key), bits)]++;
+	});
+
+	Partitioned out;
+	out.rows.resize(n);
+	out.start.assign(numParts + 1, 0);
+
+	size_t next = 0;
+	for(size_t p = 0; p < numParts; p++){
+		out.start[p] = next;
+		for(unsigned t = 0; t < numThreads; t++){
+			size_t count = counts[t][p];
+			counts[t][p] = next;
+			next += count;
+		}
+	}
+	out.start[numParts] = next;
+
+	onSlices(n, numThreads, [&](unsigned t, size_t start, size_t end){
+		vector <size_t>& place = counts[t];
+		for(size_t i = start; i < end; i++)
+			out.rows[place[partitionOf(hashKey(in[i].key), bits)]++] = in[i];
+	});
+
+	return out;
+
+}
+
+// The hash table for one partition of the build side. The keys of bucket
+// b are keys[bucketStart[b]] up to keys[bucketStart[b + 1]], with their
+// payloads at the same places in payloads
+class JoinTable{
+
+	private:
+		vector <uint32_t> keys;
+		vector <uint32_t> payloads;
+		vector <uint32_t> bucketStart;
+		size_t mask = 0;
+
+	public:
+		void build(const Tuple* rows, size_t n){
+
+			size_t numBuckets = 1;
+			while(numBuckets < n) numBuckets *= 2;
+			mask = numBuckets - 1;
+
+			bucketStart.assign(numBuckets + 1, 0);
+			for(size_t i = 0; i < n; i++) bucketStart[(hashKey(rows[i].key) & mask) + 1]++;
+			for(size_t b = 0; b < numBuckets; b++) bucketStart[b + 1] += bucketStart[b];
+
+			// 8 spare keys at the end so a SIMD load at the last bucket
+			// stays inside the vector
+			keys.assign(n + 8, 0);
+			payloads.assign(n, 0);
+			vector <uint32_t> place(bucketStart.begin(), bucketStart.end() - 1);
+			for(size_t i = 0; i < n; i++){
+				uint32_t at = place[hashKey(rows[i].key) & mask]++;
+				keys[at] = rows[i].key;
+				payloads[at] = rows[i].payload;
+			}
+
+		}
+
+		// Calls onMatch(buildPayload) for every build row with this key
+		template <typename OnMatch>
+		void probe(uint32_t key, uint64_t h, OnMatch&& onMatch) const {
+
+			size_t b = h & mask;
+			uint32_t i = bucketStart[b], end = bucketStart[b + 1];
+
+#ifdef __AVX2__
+			__m256i wanted = _mm256_set1_epi32(key);
+			for(; i < end; i += 8){
+				__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&keys[i]));
+				unsigned hits = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(x, wanted)));
+				// Lanes past the end of the bucket belong to other buckets
+				if(end - i < 8) hits &= (1u << (end - i)) - 1;
+				for(; hits; hits &= hits - 1) onMatch(payloads[i + __builtin_ctz(hits)]);
+			}
+#else
+			for(; i < end; i++)
+				if(keys[i] == key) onMatch(payloads[i]);
+#endif
+
+		}
+
+};
+
+// Enough memory partitions that a build partition takes about 256KB,
+// which fits in the L2 cache
+int partitionBitsFor(size_t buildRows){
+	int bits = 0;
+	while(bits < maxPartitionBits && (buildRows * sizeof(Tuple) * 2 >> bits) > 256 * 1024) bits++;
+	return bits;
+}
+
+// Joins build and probe in memory and calls onMatch(t, buildPayload,
+// probePayload) on thread t for every pair of rows with the same key
+template <typename OnMatch>
+void hashJoin(const vector <Tuple>& build, const vector <Tuple>& probe, unsigned numThreads, OnMatch onMatch){
+
+	if(numThreads == 0) numThreads = 1;
+	int bits = partitionBitsFor(build.size());
+	size_t numParts = size_t(1) << bits;
+
+	Partitioned builds = partition(build, bits, numThreads);
+	Partitioned probes = partition(probe, bits, numThreads);
+
+	atomic <size_t> nextPart(0);
+	onSlices(numThreads, numThreads, [&](unsigned t, size_t, size_t){
+		JoinTable table;
+		for(size_t p; (p = nextPart.fetch_add(1)) < numParts;){
+			table.build(builds.rows.data() + builds.start[p], builds.start[p + 1] - builds.start[p]);
+			for(size_t i = probes.start[p]; i < probes.start[p + 1]; i++){
+				const Tuple& row = probes.rows[i];
+				table.probe(row.key, hashKey(row.key), [&](uint32_t buildPayload){
+					onMatch(t, buildPayload, row.payload);
+				});
+			}
+		}
+	});
+
+}
+
+// ---------- SPILLING TO DISK ----------
+
+// Writes tuples to one file per spill partition, buffering each so the
+// disk sees big writes
+class SpillWriter{
+
+	private:
+		vector <ofstream> files;
+		vector <vector<Tuple>> buffers;
+		int bits;
+		static const size_t bufferRows = 8192;
+
+		void flush(size_t s){
+			files[s].write(reinterpret_cast<const char*>(buffers[s].data()), buffers[s].size() * sizeof(Tuple));
+			if(!files[s]) throw runtime_error("can't write spill file");
+			buffers[s].clear();
+		}
+
+	public:
+		SpillWriter(const string& prefix, int bits) : bits(bits) {
+			size_t numSpills = size_t(1) << bits;
+			buffers.resize(numSpills);
+			for(size_t s = 0; s < numSpills; s++){
+				files.emplace_back(prefix + to_string(s), ios::binary | ios::trunc);
+				if(!files.back()) throw runtime_error("can't create " + prefix + to_string(s));
+				buffers[s].reserve(bufferRows);
+			}
+		}
+
+		void add(const Tuple& row){
+			size_t s = spillOf(hashKey(row.key), bits);
+			buffers[s].push_back(row);
+			if(buffers[s].size() == bufferRows) flush(s);
+		}
+
+		void close(){
+			for(size_t s = 0; s < files.size(); s++){
+				flush(s);
+				files[s].close();
+			}
+		}
+
+};
+
+vector <Tuple> readSpill(const string& fileName){
+
+	ifstream reader(fileName, ios::binary | ios::ate);
+	if(!reader) throw runtime_error("can't read " + fileName);
+
+	vector <Tuple> rows(size_t(reader.tellg()) / sizeof(Tuple));
+	reader.seekg(0);
+	reader.read(reinterpret_cast<char*>(rows.data()), rows.size() * sizeof(Tuple));
+	if(!reader) throw runtime_error("can't read " + fileName);
+	return rows;
+
+}
+
+// hashJoin that keeps the build side's memory under memoryBudget bytes.
+// If the build side is bigger, both sides go to disk first in spill files
+// named spillPrefix + "b" or "p" + number. Returns how many spill
+// partitions were used, 1 if it all fit
+template <typename OnMatch>
+size_t spillingJoin(const vector <Tuple>& build, const vector <Tuple>& probe, size_t memoryBudget,
+	const string& spillPrefix, unsigned numThreads, OnMatch onMatch){
+
+	// Partitioning a build side takes it twice over
+	size_t needed = build.size() * sizeof(Tuple) * 2;
+	if(needed <= memoryBudget){
+		hashJoin(build, probe, numThreads, onMatch);
+		return 1;
+	}
+
+	int bits = 0;
+	while(bits < maxSpillBits && (needed >> bits) > memoryBudget) bits++;
+	if((needed >> bits) > memoryBudget)
+		throw runtime_error("the build side needs more than " + to_string(1 << maxSpillBits) + " spill files");
+
+	size_t numSpills = size_t(1) << bits;
+	SpillWriter buildWriter(spillPrefix + "b", bits);
+	for(const Tuple& row : build) buildWriter.add(row);
+	buildWriter.close();
+
+	SpillWriter probeWriter(spillPrefix + "p", bits);
+	for(const Tuple& row : probe) probeWriter.add(row);
+	probeWriter.close();
+
+	for(size_t s = 0; s < numSpills; s++){
+		string buildFile = spillPrefix + "b" + to_string(s);
+		string probeFile = spillPrefix + "p" + to_string(s);
+		hashJoin(readSpill(buildFile), readSpill(probeFile), numThreads, onMatch);
+		remove(buildFile.c_str());
+		remove(probeFile.c_str());
+	}
+
+	return numSpills;
+
+}
+
+// ---------- ANIMALS ----------
+// The Part1 Animal with the id of its owner
+
+class Animal{
+
+	private:
+		int height;
+		int weight;
+		string name;
+		uint32_t ownerId;
+
+	public:
+		Animal(int height, int weight, string name, uint32_t ownerId)
+			: height(height), weight(weight), name(name), ownerId(ownerId) {}
+
+		int getHeight() const { return height; }
+		int getWeight() const { return weight; }
+		string getName() const { return name; }
+		uint32_t getOwnerId() const { return ownerId; }
+
+};
+
+struct Owner{
+	uint32_t id;
+	string name;
+	string city;
+};
+
+// Time how long it takes to run a function in milliseconds
+template <typename Func>
+double timeIt(Func func){
+
+	auto start = chrono::steady_clock::now();
+	func();
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count();
+
+}
+
+int main(int argc, char* argv[]){
+
+	// ---------- A FEW ANIMALS AND THEIR OWNERS ----------
+
+	vector <Owner> owners = {{7, "Sally", "Pittsburgh"}, {3, "Paul", "Boston"}, {9, "Derek", "Denver"}};
+	vector <Animal> animals = {{33, 10, "Fred", 3}, {36, 15, "Tom", 9}, {80, 30, "Rex", 3}, {52, 20, "Spot", 5}};
+
+	// Row numbers go in the payloads so the rows can be found afterwards
+	vector <Tuple> ownerKeys, animalKeys;
+	for(uint32_t i = 0; i < owners.size(); i++) ownerKeys.push_back({owners[i].id, i});
+	for(uint32_t i = 0; i < animals.size(); i++) animalKeys.push_back({animals[i].getOwnerId(), i});
+
+	vector <pair<uint32_t, uint32_t>> pairs;
+	hashJoin(ownerKeys, animalKeys, 1, [&](unsigned, uint32_t owner, uint32_t animal){ pairs.push_back({animal, owner}); });
+	sort(pairs.begin(), pairs.end());
+
+	for(auto& match : pairs)
+		cout << animals[match.first].getName() << " belongs to " << owners[match.second].name
+			<< " from " << owners[match.second].city << endl;
+	cout << "Spot's owner 5 isn't in the table so Spot isn't joined" << endl;
+
+	// ---------- BIG TABLES ----------
+	// Pass the number of animals, the number of owners, the memory budget
+	// in MB for the spilling join and the number of threads
+
+	size_t numAnimals = (argc > 1) ? atoll(argv[1]) : 100000000;
+	size_t numOwners = (argc > 2) ? atoll(argv[2]) : 10000000;
+	size_t budgetMB = (argc > 3) ? atoll(argv[3]) : 32;
+	unsigned numThreads = (argc > 4) ? atoi(argv[4]) : thread::hardware_concurrency();
+	if(numThreads == 0) numThreads = 1;
+	if(numOwners == 0) numOwners = 1;
+
+	// Owner ids are shuffled and about 1 animal in 6 has an owner id that
+	// isn't in the table
+	Xoshiro256pp gen(2024);
+	vector <Tuple> build(numOwners), probe(numAnimals);
+	for(uint32_t i = 0; i < numOwners; i++) build[i] = {i, i};
+	for(size_t i = numOwners; i > 1; i--) swap(build[i - 1].key, build[boundedRand(gen, i)].key);
+	for(size_t i = 0; i < numAnimals; i++)
+		probe[i] = {uint32_t(boundedRand(gen, numOwners + numOwners / 5)), uint32_t(i)};
+
+	// Every method adds up the matches and a checksum of the pairs on each
+	// thread so nothing has to store 100M pairs
+	struct Totals{ uint64_t matches = 0, checksum = 0; char pad[48]; };
+
+	auto run = [&](auto join){
+		vector <Totals> totals(numThreads);
+		double ms = timeIt([&]{
+			join([&](unsigned t, uint32_t b, uint32_t p){
+				totals[t].matches++;
+				totals[t].checksum += uint64_t(b) * 0x9e3779b97f4a7c15ULL ^ p;
+			});
+		});
+		Totals sum;
+		for(Totals& part : totals){ sum.matches += part.matches; sum.checksum += part.checksum; }
+		return make_pair(ms, sum);
+	};
+
+	cout << "Joining " << numAnimals << " animals with " << numOwners << " owners" << endl;
+
+	// One big unordered_map and no partitions, on one thread
+	auto unpartitioned = run([&](auto onMatch){
+		unordered_map <uint32_t, uint32_t> table;
+		table.reserve(build.size());
+		for(const Tuple& row : build) table.emplace(row.key, row.payload);
+		for(const Tuple& row : probe){
+			auto found = table.find(row.key);
+			if(found != table.end()) onMatch(0, found -> second, row.payload);
+		}
+	});
+
+	auto partitioned = run([&](auto onMatch){ hashJoin(build, probe, numThreads, onMatch); });
+
+	size_t numSpills = 0;
+	auto spilled = run([&](auto onMatch){
+		numSpills = spillingJoin(build, probe, budgetMB << 20, "join_spill_", numThreads, onMatch);
+	});
+
+	auto same = [&](const Totals& t){
+		return t.matches == unpartitioned.second.matches && t.checksum == unpartitioned.second.checksum;
+	};
+
+	cout << "  unordered_map          " << unpartitioned.first << " ms, " << unpartitioned.second.matches << " matches" << endl;
+	cout << "  radix partitioned      " << partitioned.first << " ms ("
+		<< unpartitioned.first / partitioned.first << "x faster), same matches " << boolalpha << same(partitioned.second) << endl;
+	cout << "  spilled to " << numSpills << " files " << spilled.first << " ms with a " << budgetMB
+		<< " MB budget, same matches " << same(spilled.second) << endl;
+
+	return 0;
+}
@@ -0,0 +1,467 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+#include <stdexcept>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include "Random.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// Squeezing Animal Columns
+// Heights are stored in 32 bit ints, but real heights go from about 20 to
+// 220 cms and fit in 8 bits. Weights fit in 10. And millions of animals
+// share a few thousand names, each kept in its own string
+//
+// PackedColumn stores ints with frame of reference bit packing. It finds
+// the smallest value (the base) and stores each value minus the base in
+// just as many bits as the biggest difference needs, one value right after
+// the other with no gaps
+//
+// Names are dictionary encoded. Every different name is stored once in a
+// sorted dictionary and each animal keeps the number of its name there,
+// packed the same way. Because the dictionary is sorted, comparing numbers
+// gives the same answer as comparing the names
+//
+// Questions like "heights between 50 and 80" are answered on the packed
+// bits. The bounds are turned into packed numbers once, and then each
+// group of 8 values is unpacked into a register with AVX2, compared and
+// turned into 8 bits of a bitmap without ever being written out as ints.
+// Bitmaps for different columns are combined with &
+//
+// 8 values of b bits take exactly b bytes, so every group of 8 starts on a
+// byte. With at most 16 bits a group fits in 16 bytes and one shuffle puts
+// the bytes of each value in its own 32 bit lane. Wider columns use the
+// plain loop
+
+// One bit per row, row i is bit i % 8 of byte i / 8
+typedef vector <uint8_t> Bitmap;
+
+Bitmap operator&(const Bitmap& a, const Bitmap& b){
+	if(a.size() != b.size()) throw invalid_argument("bitmaps for different numbers of rows");
+	Bitmap result(a.size());
+	for(size_t i = 0; i < a.size(); i++) result[i] = a[i] & b[i];
+	return result;
+}
+
+size_t countRows(const Bitmap& bitmap){
+	size_t count = 0;
+	for(uint8_t byte : bitmap) count += __builtin_popcount(byte);
+	return count;
+}
+
+class PackedColumn{
+
+	private:
+		size_t count = 0;
+		int base = 0;
+		int bits = 0;
+		uint32_t mask = 0;
+		// 16 spare bytes at the end so every read of 8 or 16 bytes stays
+		// inside the vector
+		vector <uint8_t> bytes;
+
+		uint64_t read64(size_t at) const {
+			uint64_t word;
+			memcpy(&word, &bytes[at], 8);
+			return word;
+		}
+
+		uint32_t code(size_t i) const {
+			size_t bit = i * bits;
+			return uint32_t(read64(bit / 8) >> (bit % 8)) & mask;
+		}
+
+#ifdef __AVX2__
+		// The shuffle and shifts that unpack a group of 8 values of this
+		// many bits. Lane j takes the 3 bytes its value starts in, or fewer
+		// at the end of the group where the value needs fewer
+		__m256i shuffle, shifts;
+
+		void setUpUnpacking(){
+			alignas(32) uint8_t order[32];
+			alignas(32) uint32_t shiftBy[8];
+			for(int j = 0; j < 8; j++){
+				int bit = j * bits;
+				for(int k = 0; k < 4; k++) order[4 * j + k] = (k < 3 && bit / 8 + k < 16) ? bit / 8 + k : 0x80;
+				shiftBy[j] = bit % 8;
+			}
+			shuffle = _mm256_load_si256(reinterpret_cast<const __m256i*>(order));
+			shifts = _mm256_load_si256(reinterpret_cast<const __m256i*>(shiftBy));
+		}
+
+		// Packed numbers of group g, one per 32 bit lane
+		__m256i unpackGroup(size_t g) const {
+			__m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&bytes[g * bits]));
+			__m256i both = _mm256_broadcastsi128_si256(raw);
+			__m256i lanes = _mm256_srlv_epi32(_mm256_shuffle_epi8(both, shuffle), shifts);
+			return _mm256_and_si256(lanes, _mm256_set1_epi32(mask));
+		}
+#endif
+
+		bool simd() const {
+#ifdef __AVX2__
+			return bits <= 16;
+#else
+			return false;
+#endif
+		}
+
+	public:
+		PackedColumn() : bytes(16, 0) {
+#ifdef __AVX2__
+			setUpUnpacking();
+#endif
+		}
+
+		explicit PackedColumn(const vector <int>& values) : count(values.size()) {
+
+			if(!values.empty()){
+				auto [low, high] = minmax_element(values.begin(), values.end());
+				base = *low;
+				uint32_t range = uint32_t(int64_t(*high) - *low);
+				while(bits < 32 && (range >> bits) != 0) bits++;
+			}
+			mask = bits == 32 ? 0xffffffffu : (1u << bits) - 1;
+
+			bytes.assign((count * bits + 7) / 8 + 16, 0);
+			for(size_t i = 0; i < count; i++){
+				size_t bit = i * bits;
+				uint64_t word = read64(bit / 8) | (uint64_t(uint32_t(int64_t(values[i]) - base)) << (bit % 8));
+				memcpy(&bytes[bit / 8], &word, 8);
+			}
+
+#ifdef __AVX2__
+			setUpUnpacking();
+#endif
+
+		}
+
+		size_t size() const { return count; }
+		int bitsPerValue() const { return bits; }
+		size_t memoryBytes() const { return bytes.size() + sizeof(*this); }
+
+		int operator[](size_t i) const { return int(int64_t(base) + code(i)); }
+
+		int at(size_t i) const {
+			if(i >= count) throw out_of_range("row " + to_string(i) + " of " + to_string(count));
+			return (*this)[i];
+		}
+
+		// Writes rows start up to start + n into out
+		void unpack(size_t start, size_t n, int* out) const {
+
+			if(start + n > count) throw out_of_range("unpacking past the end of the column");
+			size_t i = start;
+
+#ifdef __AVX2__
+			if(simd()){
+				for(; i % 8 != 0 && i < start + n; i++) *out++ = (*this)[i];
+				__m256i offset = _mm256_set1_epi32(base);
+				for(; i + 8 <= start + n; i += 8, out += 8)
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_add_epi32(unpackGroup(i / 8), offset));
+			}
+#endif
+
+			for(; i < start + n; i++) *out++ = (*this)[i];
+
+		}
+
+		// The rows with low <= value <= high
+		Bitmap selectBetween(int low, int high) const {
+
+			Bitmap result((count + 7) / 8, 0);
+
+			// Clamp the bounds to the packed range. If nothing can match
+			// the bitmap stays empty
+			int64_t from = max<int64_t>(int64_t(low) - base, 0);
+			int64_t to = min<int64_t>(int64_t(high) - base, mask);
+			if(from > to) return result;
+			uint32_t first = from, last = to;
+
+			size_t g = 0;
+
+#ifdef __AVX2__
+			if(simd()){
+				// Packed numbers are below 2^16 so signed compares work
+				__m256i below = _mm256_set1_epi32(int(first) - 1);
+				__m256i above = _mm256_set1_epi32(int(last) + 1);
+				for(; g < count / 8; g++){
+					__m256i x = unpackGroup(g);
+					__m256i in = _mm256_and_si256(_mm256_cmpgt_epi32(x, below), _mm256_cmpgt_epi32(above, x));
+					result[g] = _mm256_movemask_ps(_mm256_castsi256_ps(in));
+				}
+			}
+#endif
+
+			for(size_t i = g * 8; i < count; i++){
+				uint32_t c = code(i);
+				if(c >= first && c <= last) result[i / 8] |= 1 << (i % 8);
+			}
+
+			return result;
+
+		}
+
+		Bitmap selectEqual(int value) const { return selectBetween(value, value); }
+
+};
+
+// Names as numbers into a sorted dictionary of the different names
+class NameColumn{
+
+	private:
+		vector <string> dictionary;
+		PackedColumn codes;
+
+	public:
+		NameColumn() {}
+
+		explicit NameColumn(const vector <string>& names){
+
+			unordered_map <string, int> numberOf;
+			for(const string& name : names) numberOf.emplace(name, 0);
+
+			dictionary.reserve(numberOf.size());
+			for(auto& entry : numberOf) dictionary.push_back(entry.first);
+			sort(dictionary.begin(), dictionary.end());
+			for(size_t c = 0; c < dictionary.size(); c++) numberOf[dictionary[c]] = c;
+
+			vector <int> numbers(names.size());
+			for(size_t i = 0; i < names.size(); i++) numbers[i] = numberOf[names[i]];
+			codes = PackedColumn(numbers);
+
+		}
+
+		// The number of name, or -1 if no row has it
+		int codeOf(const string& name) const {
+			auto found = lower_bound(dictionary.begin(), dictionary.end(), name);
+			return (found != dictionary.end() && *found == name) ? found - dictionary.begin() : -1;
+		}
+
+		size_t size() const { return codes.size(); }
+		size_t numNames() const { return dictionary.size(); }
+		const string& operator[](size_t i) const { return dictionary[codes[i]]; }
+		const PackedColumn& packed() const { return codes; }
+
+		size_t memoryBytes() const {
+			size_t total = codes.memoryBytes() + dictionary.capacity() * sizeof(string);
+			for(const string& name : dictionary) if(name.size() > 15) total += name.capacity() + 1;
+			return total;
+		}
+
+		// A name that isn't in the dictionary matches nothing without
+		// looking at any rows
+		Bitmap selectEqual(const string& name) const {
+			int code = codeOf(name);
+			if(code < 0) return Bitmap((size() + 7) / 8, 0);
+			return codes.selectEqual(code);
+		}
+
+		// Names with low <= name < high, found as a range of numbers
+		Bitmap selectRange(const string& low, const string& high) const {
+			int first = lower_bound(dictionary.begin(), dictionary.end(), low) - dictionary.begin();
+			int last = int(lower_bound(dictionary.begin(), dictionary.end(), high) - dictionary.begin()) - 1;
+			return codes.selectBetween(first, last);
+		}
+
+};
+
+// ---------- ANIMALS ----------
+
+class Animal{
+
+	private:
+		int height;
+		int weight;
+		string name;
+
+	public:
+		Animal(int height, int weight, string name) : height(height), weight(weight), name(name) {}
+
+		int getHeight() const { return height; }
+		int getWeight() const { return weight; }
+		string getName() const { return name; }
+		const string& nameRef() const { return name; }
+
+};
+
+// Every animal as three compressed columns
+class CompressedAnimals{
+
+	private:
+		PackedColumn heightColumn;
+		PackedColumn weightColumn;
+		NameColumn nameColumn;
+
+	public:
+		explicit CompressedAnimals(const vector <Animal>& animals){
+			vector <int> values(animals.size());
+			for(size_t i = 0; i < animals.size(); i++) values[i] = animals[i].getHeight();
+			heightColumn = PackedColumn(values);
+			for(size_t i = 0; i < animals.size(); i++) values[i] = animals[i].getWeight();
+			weightColumn = PackedColumn(values);
+
+			vector <string> names(animals.size());
+			for(size_t i = 0; i < animals.size(); i++) names[i] = animals[i].nameRef();
+			nameColumn = NameColumn(names);
+		}
+
+		size_t size() const { return heightColumn.size(); }
+
+		Animal get(size_t i) const {
+			if(i >= size()) throw out_of_range("there is no animal " + to_string(i));
+			return Animal(heightColumn[i], weightColumn[i], nameColumn[i]);
+		}
+
+		const PackedColumn& heights() const { return heightColumn; }
+		const PackedColumn& weights() const { return weightColumn; }
+		const NameColumn& names() const { return nameColumn; }
+
+		size_t memoryBytes() const {
+			return heightColumn.memoryBytes() + weightColumn.memoryBytes() + nameColumn.memoryBytes();
+		}
+
+};
+
+// Time how long it takes to run a function in milliseconds
+template <typename Func>
+double timeIt(Func func){
+
+	auto start = chrono::steady_clock::now();
+	func();
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count();
+
+}
+
+int main(int argc, char* argv[]){
+
+	// Pass the number of animals and the number of different names
+	size_t n = (argc > 1) ? atoll(argv[1]) : 20000000;
+	size_t numNames = (argc > 2) ? atoll(argv[2]) : 1000;
+	if(numNames == 0) numNames = 1;
+
+	Xoshiro256pp gen(2024);
+	vector <Animal> animals;
+	animals.reserve(n);
+	for(size_t i = 0; i < n; i++)
+		animals.emplace_back(20 + boundedRand(gen, 200), 1 + boundedRand(gen, 1000),
+			"Rex" + to_string(boundedRand(gen, numNames)));
+
+	// Plain columns for comparison: ints and strings
+	vector <int> heights(n), weights(n);
+	vector <string> names(n);
+	for(size_t i = 0; i < n; i++){
+		heights[i] = animals[i].getHeight();
+		weights[i] = animals[i].getWeight();
+		names[i] = animals[i].nameRef();
+	}
+
+	CompressedAnimals packed(animals);
+
+	// ---------- MEMORY ----------
+
+	size_t objectBytes = animals.capacity() * sizeof(Animal);
+	size_t columnBytes = (heights.capacity() + weights.capacity()) * sizeof(int) + names.capacity() * sizeof(string);
+	size_t intBytes = (heights.capacity() + weights.capacity()) * sizeof(int) + n * sizeof(int);
+	size_t packedBytes = packed.memoryBytes();
+
+	cout << n << " animals, " << packed.names().numNames() << " different names" << endl;
+	cout << "  heights " << packed.heights().bitsPerValue() << " bits, weights " << packed.weights().bitsPerValue()
+		<< " bits, names " << packed.names().packed().bitsPerValue() << " bits" << endl;
+	cout << "  Animal objects        " << objectBytes / 1e6 << " MB" << endl;
+	cout << "  int and string columns " << columnBytes / 1e6 << " MB" << endl;
+	cout << "  int columns, name ids " << intBytes / 1e6 << " MB" << endl;
+	cout << "  compressed            " << packedBytes / 1e6 << " MB (" << double(objectBytes) / packedBytes
+		<< "x smaller than objects, " << double(intBytes) / packedBytes << "x smaller than int columns)" << endl;
+
+	// ---------- SCANS ----------
+	// Animals 50 to 80 cms tall, 100 to 500 kgs and named Rex42
+
+	const string wanted = "Rex42";
+	size_t objectCount = 0, columnCount = 0, packedCount = 0;
+
+	double objectTime = timeIt([&]{
+		for(const Animal& a : animals)
+			objectCount += a.getHeight() >= 50 && a.getHeight() <= 80 && a.getWeight() >= 100 &&
+				a.getWeight() <= 500 && a.nameRef() == wanted;
+	});
+
+	double columnTime = timeIt([&]{
+		for(size_t i = 0; i < n; i++)
+			columnCount += heights[i] >= 50 && heights[i] <= 80 && weights[i] >= 100 &&
+				weights[i] <= 500 && names[i] == wanted;
+	});
+
+	double packedTime = timeIt([&]{
+		Bitmap rows = packed.heights().selectBetween(50, 80) & packed.weights().selectBetween(100, 500) &
+			packed.names().selectEqual(wanted);
+		packedCount = countRows(rows);
+	});
+
+	cout << "Height 50 to 80, weight 100 to 500, named " << wanted << endl;
+	cout << "  Animal objects  " << objectTime << " ms, " << objectCount << " animals" << endl;
+	cout << "  plain columns   " << columnTime << " ms, " << columnCount << " animals" << endl;
+	cout << "  compressed      " << packedTime << " ms, " << packedCount << " animals ("
+		<< columnTime / packedTime << "x faster than plain columns)" << endl;
+
+	// Heights alone against a plain int column
+	size_t plainTall = 0, packedTall = 0;
+	double plainTallTime = timeIt([&]{
+		for(int h : heights) plainTall += h >= 50 && h <= 80;
+	});
+	double packedTallTime = timeIt([&]{ packedTall = countRows(packed.heights().selectBetween(50, 80)); });
+
+	cout << "Height 50 to 80 only" << endl;
+	cout << "  int column " << plainTallTime << " ms, compressed " << packedTallTime << " ms, same count "
+		<< boolalpha << (plainTall == packedTall) << endl;
+
+	// Names starting with Rex1 are a range in the sorted dictionary
+	size_t plainRex1 = 0;
+	for(const string& name : names) plainRex1 += name.compare(0, 4, "Rex1") == 0;
+	cout << "Names starting with Rex1: " << countRows(packed.names().selectRange("Rex1", "Rex2"))
+		<< ", by comparing strings " << plainRex1 << endl;
+
+	// ---------- DECODING ----------
+
+	vector <int> buffer(4096);
+	long long plainSum = 0, packedSum = 0;
+	double unpackTime = timeIt([&]{
+		for(size_t start = 0; start < n; start += buffer.size()){
+			size_t len = min(buffer.size(), n - start);
+			packed.weights().unpack(start, len, buffer.data());
+			for(size_t i = 0; i < len; i++) packedSum += buffer[i];
+		}
+	});
+	double oneByOneTime = timeIt([&]{
+		for(size_t i = 0; i < n; i++) plainSum += packed.weights()[i];
+	});
+
+	bool same = plainSum == packedSum;
+	for(size_t i = 0; i < n && same; i += n / 1000 + 1){
+		Animal a = packed.get(i);
+		same = a.getHeight() == animals[i].getHeight() && a.getWeight() == animals[i].getWeight() &&
+			a.nameRef() == animals[i].nameRef();
+	}
+
+	cout << "Decoding every weight: unpack " << unpackTime << " ms, one at a time " << oneByOneTime
+		<< " ms, decodes right " << same << endl;
+
+	try{
+		packed.get(n);
+	}
+	catch(out_of_range& e){
+		cout << e.what() << endl;
+	}
+
+	return 0;
+}
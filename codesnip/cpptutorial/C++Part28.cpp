@@ -0,0 +1,549 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <functional>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include "Random.h"
+
+using namespace std;
+
+// Weight and Height History
+// To see how animals grow we keep every setWeight and setHeight with the
+// time it happened. Stored plainly each change is a 64 bit time and a 64
+// bit value, 16 bytes, and there are a lot of changes
+//
+// Series stores them the way Facebook's Gorilla database does
+// Times come at nearly regular intervals, so the difference between one
+// gap and the next (the delta of delta) is usually 0 and takes 1 bit
+// Values change slowly, so a value XORed with the one before is usually 0
+// (1 bit) or has only a few bits set in the middle. Only those bits are
+// stored, and when they sit inside the same window as last time the window
+// isn't stored again
+//
+// Points are packed into blocks of up to 1024. Each block keeps its first
+// and last time and its smallest and biggest value, so a scan of a time
+// range or of values above some limit skips blocks that can't match
+// without decoding them
+
+struct Point{
+	int64_t time;
+	double value;
+};
+
+// Bits written from the top of each 64 bit word down
+class BitWriter{
+
+	private:
+		vector <uint64_t> words;
+		size_t numBits = 0;
+
+	public:
+		// The low n bits of value, n from 1 to 64
+		void write(uint64_t value, int n){
+			if(n < 64) value &= (uint64_t(1) << n) - 1;
+			size_t used = numBits % 64;
+			if(used == 0) words.push_back(0);
+			words.back() |= (value << (64 - n)) >> used;
+			if(used + n > 64){
+				words.push_back(value << (128 - n - used));
+			}
+			numBits += n;
+		}
+
+		void writeBit(bool bit){ write(bit, 1); }
+
+		size_t size() const { return numBits; }
+		const vector <uint64_t>& data() const { return words; }
+		void shrink(){ words.shrink_to_fit(); }
+		size_t memoryBytes() const { return words.capacity() * sizeof(uint64_t); }
+
+};
+
+class BitReader{
+
+	private:
+		const uint64_t* words;
+		size_t position = 0;
+
+	public:
+		explicit BitReader(const vector <uint64_t>& words) : words(words.data()) {}
+
+		// The next n bits without moving past them
+		uint64_t peek(int n) const {
+			size_t used = position % 64;
+			const uint64_t* word = words + position / 64;
+			uint64_t value = (word[0] << used);
+			if(used + n > 64) value |= word[1] >> (64 - used);
+			return n == 64 ? value : value >> (64 - n);
+		}
+
+		uint64_t read(int n){
+			uint64_t value = peek(n);
+			position += n;
+			return value;
+		}
+
+		void skip(int n){ position += n; }
+
+		bool readBit(){ return read(1); }
+
+};
+
+inline uint64_t bitsOf(double value){ uint64_t bits; memcpy(&bits, &value, 8); return bits; }
+inline double valueOf(uint64_t bits){ double value; memcpy(&value, &bits, 8); return value; }
+
+// Two's complement of the low n bits back to a signed number
+inline int64_t signExtend(uint64_t value, int n){
+	return int64_t(value << (64 - n)) >> (64 - n);
+}
+
+class Series{
+
+	private:
+		static const uint32_t blockSize = 1024;
+
+		struct Block{
+			int64_t firstTime, lastTime;
+			double minValue, maxValue;
+			uint32_t count;
+			BitWriter bits;
+		};
+
+		vector <Block> blocks;
+
+		// What the next point in the last block is compared with
+		int64_t lastTime = 0, lastDelta = 0;
+		uint64_t lastBits = 0;
+		int lastLeading = 0, lastTrailing = 0;
+
+		void appendTime(BitWriter& out, int64_t time){
+			int64_t delta = time - lastTime;
+			int64_t dod = delta - lastDelta;
+			// n bits of two's complement hold -2^(n-1) up to 2^(n-1) - 1
+			if(dod == 0) out.writeBit(0);
+			else if(dod >= -64 && dod <= 63){ out.write(0b10, 2); out.write(dod, 7); }
+			else if(dod >= -256 && dod <= 255){ out.write(0b110, 3); out.write(dod, 9); }
+			else if(dod >= -2048 && dod <= 2047){ out.write(0b1110, 4); out.write(dod, 12); }
+			else{ out.write(0b1111, 4); out.write(dod, 64); }
+			lastDelta = delta;
+			lastTime = time;
+		}
+
+		void appendValue(BitWriter& out, double value){
+			uint64_t bits = bitsOf(value);
+			uint64_t x = bits ^ lastBits;
+			lastBits = bits;
+
+			if(x == 0){
+				out.writeBit(0);
+				return;
+			}
+			out.writeBit(1);
+
+			// Leading zeros are stored in 5 bits so at most 31 are counted
+			int leading = min(__builtin_clzll(x), 31);
+			int trailing = __builtin_ctzll(x);
+
+			if(lastLeading + lastTrailing > 0 && leading >= lastLeading && trailing >= lastTrailing){
+				out.writeBit(0);
+				out.write(x >> lastTrailing, 64 - lastLeading - lastTrailing);
+			}
+			else{
+				int meaningful = 64 - leading - trailing;
+				out.writeBit(1);
+				out.write(leading, 5);
+				out.write(meaningful - 1, 6);
+				out.write(x >> trailing, meaningful);
+				lastLeading = leading;
+				lastTrailing = trailing;
+			}
+		}
+
+		// Decodes the points of a block in order until func returns false
+		template <typename Func>
+		static void decode(const Block& block, Func func){
+
+			BitReader in(block.bits.data());
+			int64_t time = in.read(64);
+			uint64_t bits = in.read(64);
+			if(!func(time, valueOf(bits))) return;
+
+			int64_t delta = 0;
+			int leading = 0, trailing = 0;
+
+			for(uint32_t i = 1; i < block.count; i++){
+
+				// Same gap and same value is the common case and is 00
+				if(in.peek(2) == 0){
+					in.skip(2);
+					time += delta;
+					if(!func(time, valueOf(bits))) return;
+					continue;
+				}
+
+				if(in.readBit()){
+					int64_t dod;
+					if(!in.readBit()) dod = signExtend(in.read(7), 7);
+					else if(!in.readBit()) dod = signExtend(in.read(9), 9);
+					else if(!in.readBit()) dod = signExtend(in.read(12), 12);
+					else dod = in.read(64);
+					delta += dod;
+				}
+				time += delta;
+
+				if(in.readBit()){
+					if(in.readBit()){
+						leading = in.read(5);
+						int meaningful = in.read(6) + 1;
+						trailing = 64 - leading - meaningful;
+					}
+					bits ^= in.read(64 - leading - trailing) << trailing;
+				}
+
+				if(!func(time, valueOf(bits))) return;
+
+			}
+
+		}
+
+	public:
+		// Times have to come in order. Equal times are allowed
+		void append(int64_t time, double value){
+
+			if(!blocks.empty() && time < blocks.back().lastTime)
+				throw invalid_argument("time " + to_string(time) + " is before the last point at " +
+					to_string(blocks.back().lastTime));
+
+			if(blocks.empty() || blocks.back().count == blockSize){
+				if(!blocks.empty()) blocks.back().bits.shrink();
+				blocks.push_back({time, time, value, value, 1, BitWriter()});
+				blocks.back().bits.write(time, 64);
+				blocks.back().bits.write(bitsOf(value), 64);
+				lastTime = time;
+				lastDelta = 0;
+				lastBits = bitsOf(value);
+				lastLeading = lastTrailing = 0;
+				return;
+			}
+
+			Block& block = blocks.back();
+			appendTime(block.bits, time);
+			appendValue(block.bits, value);
+			block.lastTime = time;
+			block.minValue = min(block.minValue, value);
+			block.maxValue = max(block.maxValue, value);
+			block.count++;
+
+		}
+
+		size_t size() const {
+			return blocks.empty() ? 0 : (blocks.size() - 1) * blockSize + blocks.back().count;
+		}
+
+		size_t memoryBytes() const {
+			size_t total = sizeof(*this) + blocks.capacity() * sizeof(Block);
+			for(const Block& block : blocks) total += block.bits.memoryBytes();
+			return total;
+		}
+
+		// Calls func(time, value) for every point with from <= time <= to
+		template <typename Func>
+		void scan(int64_t from, int64_t to, Func func) const {
+			scanValues(from, to, -numeric_limits<double>::infinity(), numeric_limits<double>::infinity(), func);
+		}
+
+		// Only the points that also have low <= value <= high
+		template <typename Func>
+		void scanValues(int64_t from, int64_t to, double low, double high, Func func) const {
+
+			// The first block that could have a time at or after from
+			auto first = lower_bound(blocks.begin(), blocks.end(), from,
+				[](const Block& block, int64_t t){ return block.lastTime < t; });
+
+			// Decoding stops at the first time past to
+			for(auto block = first; block != blocks.end() && block -> firstTime <= to; ++block){
+				if(block -> maxValue < low || block -> minValue > high) continue;
+				decode(*block, [&](int64_t time, double value){
+					if(time > to) return false;
+					if(time >= from && value >= low && value <= high) func(time, value);
+					return true;
+				});
+			}
+
+		}
+
+		int64_t firstTime() const { return blocks.empty() ? 0 : blocks.front().firstTime; }
+		int64_t lastTimeSeen() const { return blocks.empty() ? 0 : blocks.back().lastTime; }
+
+};
+
+// ---------- ANIMALS ----------
+
+// Every animal's heights and weights over time. The clock gives the time
+// in ms of each change and is the system clock unless one is given
+class History{
+
+	private:
+		struct Record{
+			Series heights;
+			Series weights;
+		};
+
+		vector <Record> records;
+		function <int64_t()> clock;
+
+	public:
+		History() : clock([]{
+			return chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+		}) {}
+
+		explicit History(function <int64_t()> clock) : clock(clock) {}
+
+		uint32_t newAnimal(){
+			records.emplace_back();
+			return records.size() - 1;
+		}
+
+		void recordHeight(uint32_t id, int height){ records.at(id).heights.append(clock(), height); }
+		void recordWeight(uint32_t id, int weight){ records.at(id).weights.append(clock(), weight); }
+
+		const Series& heights(uint32_t id) const { return records.at(id).heights; }
+		const Series& weights(uint32_t id) const { return records.at(id).weights; }
+
+		size_t numAnimals() const { return records.size(); }
+
+		size_t memoryBytes() const {
+			size_t total = records.capacity() * sizeof(Record);
+			for(const Record& record : records)
+				total += record.heights.memoryBytes() + record.weights.memoryBytes() - 2 * sizeof(Series);
+			return total;
+		}
+
+};
+
+// The Part1 Animal. With a History every change is recorded
+class Animal{
+
+	private:
+		int height;
+		int weight;
+		string name;
+		History* history;
+		uint32_t id;
+
+	public:
+		Animal(int height, int weight, string name, History* history = nullptr)
+			: height(height), weight(weight), name(name), history(history), id(0) {
+			if(history){
+				id = history -> newAnimal();
+				history -> recordHeight(id, height);
+				history -> recordWeight(id, weight);
+			}
+		}
+
+		int getHeight() const { return height; }
+		int getWeight() const { return weight; }
+		string getName() const { return name; }
+		uint32_t getId() const { return id; }
+
+		// Recorded first so a change the history refuses isn't made
+		void setHeight(int cm){
+			if(history) history -> recordHeight(id, cm);
+			height = cm;
+		}
+
+		void setWeight(int kg){
+			if(history) history -> recordWeight(id, kg);
+			weight = kg;
+		}
+
+};
+
+// Time how long it takes to run a function in milliseconds
+template <typename Func>
+double timeIt(Func func){
+
+	auto start = chrono::steady_clock::now();
+	func();
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count();
+
+}
+
+int main(int argc, char* argv[]){
+
+	// A simulated clock so the demo doesn't take weeks
+	const int64_t day = 24 * 60 * 60 * 1000LL;
+	int64_t now = 1700000000000LL;
+	auto clock = [&now]{ return now; };
+
+	// ---------- FRED GROWS UP ----------
+
+	{
+		History history(clock);
+		Animal fred(20, 2, "Fred", &history);
+
+		for(int d = 1; d <= 365; d++){
+			now += day;
+			if(d % 7 == 0) fred.setHeight(20 + d / 10);
+			fred.setWeight(2 + d / 20);
+		}
+
+		const Series& weights = history.weights(fred.getId());
+		cout << "Fred's weight was recorded " << weights.size() << " times in " << weights.memoryBytes()
+			<< " bytes, " << weights.size() * sizeof(Point) << " as plain points" << endl;
+
+		cout << "Fred's height in his last month:";
+		history.heights(fred.getId()).scan(now - 30 * day, now, [](int64_t, double cm){ cout << " " << cm; });
+		cout << endl;
+
+		try{
+			now -= 2 * day;
+			fred.setWeight(30);
+		}
+		catch(invalid_argument& e){
+			cout << e.what() << endl;
+		}
+	}
+
+	// ---------- EVERY KIND OF GAP ----------
+	// Gap changes right at the edges of each delta of delta size, both
+	// signs, read back exactly
+
+	{
+		Series edges;
+		vector <Point> written;
+		int64_t time = 0, gap = 100000;
+		double value = 1.5;
+
+		for(int64_t dod : {0LL, 63LL, 64LL, -64LL, -65LL, 255LL, 256LL, -256LL, -257LL,
+			2047LL, 2048LL, -2048LL, -2049LL, 1LL << 40, -(1LL << 40)}){
+			gap += dod;
+			time += gap;
+			value = value * -1.75 + 3;
+			edges.append(time, value);
+			written.push_back({time, value});
+		}
+
+		size_t i = 0;
+		bool same = true;
+		edges.scan(numeric_limits<int64_t>::min(), numeric_limits<int64_t>::max(), [&](int64_t t, double v){
+			same = same && i < written.size() && written[i].time == t && written[i].value == v;
+			i++;
+		});
+		cout << "Gap changes at every size edge read back right " << boolalpha << (same && i == written.size()) << endl;
+	}
+
+	// ---------- A ZOO OVER THE YEARS ----------
+	// Pass the number of animals and the number of weigh ins. Animals are
+	// weighed about once a minute and measured every 10th time
+
+	size_t numAnimals = (argc > 1) ? atoll(argv[1]) : 1000;
+	size_t numSteps = (argc > 2) ? atoll(argv[2]) : 20000;
+
+	Xoshiro256pp gen(2024);
+	History history(clock);
+	vector <Animal> animals;
+	animals.reserve(numAnimals);
+
+	// The same points kept plainly for comparison
+	vector <vector<Point>> plainWeights(numAnimals), plainHeights(numAnimals);
+
+	now = 1700000000000LL;
+	for(size_t a = 0; a < numAnimals; a++){
+		animals.emplace_back(20 + boundedRand(gen, 100), 10 + boundedRand(gen, 100), "Rex", &history);
+		plainHeights[a].push_back({now, double(animals[a].getHeight())});
+		plainWeights[a].push_back({now, double(animals[a].getWeight())});
+	}
+
+	int64_t start = now;
+	for(size_t step = 1; step <= numSteps; step++){
+		// Readings come a minute apart give or take a few ms
+		now += 60000 + boundedRand(gen, 5);
+		for(size_t a = 0; a < numAnimals; a++){
+			Animal& animal = animals[a];
+			uint64_t r = boundedRand(gen, 10);
+			int weight = animal.getWeight() + (r == 0 ? -1 : r == 1 ? 1 : 0);
+			animal.setWeight(max(weight, 1));
+			plainWeights[a].push_back({now, double(animal.getWeight())});
+			if(step % 10 == 0){
+				animal.setHeight(animal.getHeight() + (boundedRand(gen, 50) == 0));
+				plainHeights[a].push_back({now, double(animal.getHeight())});
+			}
+		}
+	}
+
+	size_t numPoints = 0;
+	for(size_t a = 0; a < numAnimals; a++) numPoints += plainWeights[a].size() + plainHeights[a].size();
+	size_t plainBytes = numPoints * sizeof(Point);
+
+	cout << numAnimals << " animals, " << numPoints << " recorded changes" << endl;
+	cout << "  plain points " << plainBytes / 1e6 << " MB, compressed " << history.memoryBytes() / 1e6 << " MB ("
+		<< double(plainBytes) / history.memoryBytes() << "x smaller, "
+		<< 8.0 * history.memoryBytes() / numPoints << " bits a point)" << endl;
+
+	// ---------- SCANS ----------
+
+	// Average weight over everything
+	double plainSum = 0, packedSum = 0;
+	double plainAll = timeIt([&]{
+		for(auto& series : plainWeights) for(const Point& p : series) plainSum += p.value;
+	});
+	double packedAll = timeIt([&]{
+		for(size_t a = 0; a < numAnimals; a++)
+			history.weights(a).scan(start, now, [&](int64_t, double kg){ packedSum += kg; });
+	});
+
+	size_t weighIns = numAnimals * (numSteps + 1);
+	cout << "Average of every weight" << endl;
+	cout << "  plain " << plainAll << " ms, compressed " << packedAll << " ms ("
+		<< weighIns / packedAll / 1000 << "M points/s), same " << boolalpha << (plainSum == packedSum) << endl;
+
+	// A window of 5% of the time from 40% of the way in. Plain points use
+	// a binary search, the compressed blocks are skipped by their first
+	// and last times and decoding stops at the end of the window
+	int64_t from = start + (now - start) / 5 * 2, to = from + (now - start) / 20;
+	double plainWindowSum = 0, packedWindowSum = 0;
+	double plainWindow = timeIt([&]{
+		for(auto& series : plainWeights){
+			auto p = lower_bound(series.begin(), series.end(), from,
+				[](const Point& point, int64_t t){ return point.time < t; });
+			for(; p != series.end() && p -> time <= to; ++p) plainWindowSum += p -> value;
+		}
+	});
+	double packedWindow = timeIt([&]{
+		for(size_t a = 0; a < numAnimals; a++)
+			history.weights(a).scan(from, to, [&](int64_t, double kg){ packedWindowSum += kg; });
+	});
+
+	cout << "Weights in 5% of the time" << endl;
+	cout << "  plain " << plainWindow << " ms, compressed " << packedWindow << " ms, same "
+		<< (plainWindowSum == packedWindowSum) << endl;
+
+	// Rare heavy readings. Blocks whose biggest weight is too small are
+	// skipped without being decoded
+	double heavy = 0;
+	for(const Animal& animal : animals) heavy = max(heavy, double(animal.getWeight()));
+	heavy -= 2;
+
+	size_t plainHeavy = 0, packedHeavy = 0;
+	double plainHeavyTime = timeIt([&]{
+		for(auto& series : plainWeights) for(const Point& p : series) plainHeavy += p.value >= heavy;
+	});
+	double packedHeavyTime = timeIt([&]{
+		for(size_t a = 0; a < numAnimals; a++)
+			history.weights(a).scanValues(start, now, heavy, 1e300, [&](int64_t, double){ packedHeavy++; });
+	});
+
+	cout << "Weights of at least " << heavy << endl;
+	cout << "  plain " << plainHeavyTime << " ms, compressed " << packedHeavyTime << " ms, same "
+		<< (plainHeavy == packedHeavy) << " (" << plainHeavy << " readings)" << endl;
+
+	return 0;
+}
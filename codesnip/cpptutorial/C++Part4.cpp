@@ -0,0 +1,421 @@
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <chrono>
+#include <iterator>
+using namespace std;
+
+// Gap Buffers and Double Ended Vectors
+// A vector keeps its spare room only at the end, so inserting at the front
+// or in the middle has to shift every element that comes after it
+// A GapVector keeps spare room in 3 places : before the first element,
+// after the last element and in a movable gap in the middle
+//
+// [ front spare | first part | gap | second part | back spare ]
+//
+// push_front and push_back just write into the spare room on their side
+// Inserting in the middle moves the gap to that spot first. Inserts that
+// are close together only move the few elements between them
+
+template <typename T>
+class GapVector{
+
+	// We copy elements around with memmove so we only accept types like
+	// int, char and double that can be copied byte by byte
+	static_assert(is_trivially_copyable<T>::value,
+		"GapVector only holds trivially copyable types");
+
+	private:
+		T* buf = nullptr;
+		size_t cap = 0;
+
+		// The elements are buf[head, gapBeg) and buf[gapEnd, tail)
+		size_t head = 0;
+		size_t gapBeg = 0;
+		size_t gapEnd = 0;
+		size_t tail = 0;
+
+		size_t firstSize() const { return gapBeg - head; }
+
+		// Slide the gap so that it starts at the logical index pos
+		void moveGap(size_t pos){
+
+			size_t n1 = firstSize();
+
+			if(pos < n1){
+				// Elements in front of the gap move behind it
+				size_t count = n1 - pos;
+				memmove(buf + gapEnd - count, buf + head + pos, count * sizeof(T));
+				gapBeg -= count;
+				gapEnd -= count;
+			} else if(pos > n1){
+				// Elements behind the gap move in front of it
+				size_t count = pos - n1;
+				memmove(buf + gapBeg, buf + gapEnd, count * sizeof(T));
+				gapBeg += count;
+				gapEnd += count;
+			}
+
+		}
+
+		// Make at least extra free slots in the gap at logical index pos. The
+		// rest of the free room is split evenly between the front, the gap
+		// and the back so whichever end we insert at next has room to grow
+		// If the buffer is at most half full the room is only in the wrong
+		// place, so the elements are spread out again in the same buffer.
+		// Only a buffer that is really full is swapped for a bigger one
+		void grow(size_t pos, size_t extra){
+
+			size_t n = size();
+
+			if(buf != nullptr && n + extra <= cap / 2){
+				size_t spare = cap - n - extra;
+				size_t newHead = spare / 3;
+				extra += spare / 3;
+
+				// Close the gap, slide everything to newHead and then open
+				// the gap again at pos. memmove is fine with the overlap
+				moveGap(n);
+				memmove(buf + newHead, buf + head, n * sizeof(T));
+				memmove(buf + newHead + pos + extra, buf + newHead + pos, (n - pos) * sizeof(T));
+
+				head = newHead;
+				gapBeg = newHead + pos;
+				gapEnd = gapBeg + extra;
+				tail = gapEnd + (n - pos);
+				return;
+			}
+
+			size_t newCap = (cap * 2 > 16) ? cap * 2 : 16;
+			while(newCap < (n + extra) * 2) newCap *= 2;
+
+			size_t spare = newCap - n - extra;
+			size_t newHead = spare / 3;
+			extra += spare / 3;
+			T* newBuf = static_cast<T*>(::operator new(newCap * sizeof(T)));
+
+			// Copy the elements in front of pos, leave the gap and then copy
+			// the rest
+			moveGap(pos);
+			if(n > 0){
+				memcpy(newBuf + newHead, buf + head, pos * sizeof(T));
+				memcpy(newBuf + newHead + pos + extra, buf + gapEnd, (n - pos) * sizeof(T));
+			}
+
+			::operator delete(buf);
+			buf = newBuf;
+			cap = newCap;
+			head = newHead;
+			gapBeg = newHead + pos;
+			gapEnd = gapBeg + extra;
+			tail = gapEnd + (n - pos);
+
+		}
+
+		// Open a gap of count free slots at logical index pos
+		void openGap(size_t pos, size_t count){
+
+			if(gapEnd - gapBeg < count) grow(pos, count);
+			else moveGap(pos);
+
+		}
+
+	public:
+
+		// The iterator walks the first part and jumps over the gap when it
+		// reaches it so a loop over the whole GapVector stays a pointer walk
+		class iterator{
+			private:
+				T* ptr;
+				const GapVector* owner;
+			public:
+				typedef bidirectional_iterator_tag iterator_category;
+				typedef T value_type;
+				typedef ptrdiff_t difference_type;
+				typedef T* pointer;
+				typedef T& reference;
+
+				iterator(T* p, const GapVector* o) : ptr(p), owner(o) {}
+
+				T& operator*() const { return *ptr; }
+				T* operator->() const { return ptr; }
+
+				iterator& operator++(){
+					++ptr;
+					if(ptr == owner -> buf + owner -> gapBeg) ptr = owner -> buf + owner -> gapEnd;
+					return *this;
+				}
+
+				iterator operator++(int){ iterator old = *this; ++*this; return old; }
+
+				iterator& operator--(){
+					if(ptr == owner -> buf + owner -> gapEnd) ptr = owner -> buf + owner -> gapBeg;
+					--ptr;
+					return *this;
+				}
+
+				iterator operator--(int){ iterator old = *this; --*this; return old; }
+
+				// Jumping by n works out the logical index and goes straight
+				// there instead of stepping n times
+				iterator operator+(ptrdiff_t n) const { return owner -> iteratorAt(index() + n); }
+				iterator operator-(ptrdiff_t n) const { return owner -> iteratorAt(index() - n); }
+
+				size_t index() const {
+					size_t pos = ptr - owner -> buf;
+					if(pos < owner -> gapEnd) return pos - owner -> head;
+					return owner -> firstSize() + (pos - owner -> gapEnd);
+				}
+
+				bool operator==(const iterator& other) const { return ptr == other.ptr; }
+				bool operator!=(const iterator& other) const { return ptr != other.ptr; }
+		};
+
+		GapVector() {}
+
+		// Like vector <int> v(10) this creates count value initialized elements
+		explicit GapVector(size_t count){
+			grow(0, 0);
+			while(size() < count) push_back(T());
+		}
+
+		GapVector(const GapVector& other){
+			for(const T& value : other) push_back(value);
+		}
+
+		GapVector& operator=(GapVector other){
+			swap(other);
+			return *this;
+		}
+
+		~GapVector(){ ::operator delete(buf); }
+
+		void swap(GapVector& other){
+			std::swap(buf, other.buf);
+			std::swap(cap, other.cap);
+			std::swap(head, other.head);
+			std::swap(gapBeg, other.gapBeg);
+			std::swap(gapEnd, other.gapEnd);
+			std::swap(tail, other.tail);
+		}
+
+		size_t size() const { return firstSize() + (tail - gapEnd); }
+		bool empty() const { return size() == 0; }
+		size_t capacity() const { return cap; }
+
+		iterator iteratorAt(size_t i) const {
+			size_t n1 = firstSize();
+			if(i < n1) return iterator(buf + head + i, this);
+			return iterator(buf + gapEnd + (i - n1), this);
+		}
+
+		iterator begin() const { return iteratorAt(0); }
+		iterator end() const { return iterator(buf + tail, this); }
+
+		// [] doesn't check the index just like with vector
+		T& operator[](size_t i){
+			size_t n1 = firstSize();
+			return (i < n1) ? buf[head + i] : buf[gapEnd + (i - n1)];
+		}
+
+		// at checks the index and throws out_of_range like vector does
+		T& at(size_t i){
+			if(i >= size()) throw out_of_range("GapVector::at");
+			return (*this)[i];
+		}
+
+		T& front(){ return (*this)[0]; }
+		T& back(){ return (*this)[size() - 1]; }
+
+		void push_back(const T& value){
+			if(tail == cap) grow(size(), 0);
+			buf[tail++] = value;
+		}
+
+		void push_front(const T& value){
+			if(head == 0) grow(0, 0);
+			buf[--head] = value;
+		}
+
+		void pop_back(){
+			// If nothing is behind the gap the last element is in front of it
+			if(tail == gapEnd){
+				--gapBeg;
+				gapEnd = tail = gapBeg;
+			} else {
+				--tail;
+			}
+		}
+
+		void pop_front(){
+			if(head == gapBeg){
+				++gapEnd;
+				head = gapBeg = gapEnd;
+			} else {
+				++head;
+			}
+		}
+
+		// Insert a value in front of the element pos points at
+		iterator insert(iterator pos, const T& value){
+
+			size_t i = pos.index();
+			if(i == 0){
+				push_front(value);
+			} else if(i == size()){
+				push_back(value);
+			} else {
+				openGap(i, 1);
+				buf[gapBeg++] = value;
+			}
+			return iteratorAt(i);
+
+		}
+
+		// Insert the values in [first, last) in front of pos. The range is
+		// walked twice, once to count it, so it has to be a forward range
+		template <typename ForwardIt>
+		iterator insert(iterator pos, ForwardIt first, ForwardIt last){
+
+			static_assert(is_base_of<forward_iterator_tag,
+				typename iterator_traits<ForwardIt>::iterator_category>::value,
+				"GapVector::insert needs forward iterators");
+
+			size_t i = pos.index();
+			size_t count = distance(first, last);
+			openGap(i, count);
+			for(; first != last; ++first) buf[gapBeg++] = *first;
+			return iteratorAt(i);
+
+		}
+
+		// Closes the gap so all elements sit side by side and returns a
+		// pointer to the first one. Use it before a hot loop that wants a
+		// plain array
+		T* data(){
+			moveGap(size());
+			return buf + head;
+		}
+
+		void clear(){ head = gapBeg = gapEnd = tail = cap / 2; }
+
+};
+
+// Time how long it takes to run a function in milliseconds
+template <typename Func>
+double timeIt(Func func){
+
+	auto start = chrono::steady_clock::now();
+	func();
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count();
+
+}
+
+int main(){
+
+	// ---------- THE VECTOR EXAMPLE WITH A GAPVECTOR ----------
+	// These are the same steps as the VECTORS section in Part1
+
+	GapVector <int> lotteryNumVect(10);
+
+	int lotteryNumArray[5] = {4, 13, 14, 24, 34};
+
+	// Add the array to the front. A range insert always goes through the
+	// gap, so the gap moves to the front and the values are copied into it
+	lotteryNumVect.insert(lotteryNumVect.begin(), lotteryNumArray, lotteryNumArray+3);
+
+	// Insert a value into the 5th index. This opens the gap there
+	lotteryNumVect.insert(lotteryNumVect.begin()+5, 44);
+
+	cout << "Value in 5 " << lotteryNumVect.at(5) << endl;
+
+	lotteryNumVect.push_back(64);
+
+	cout << "Final Value " << lotteryNumVect.back() << endl;
+
+	lotteryNumVect.pop_back();
+
+	cout << "First Element " << lotteryNumVect.front() << endl;
+	cout << "Last Element " << lotteryNumVect.back() << endl;
+	cout << "Vector Empty " << lotteryNumVect.empty() << endl;
+	cout << "Number of Vector Elements " << lotteryNumVect.size() << endl;
+
+	// Iterating skips over the gap
+	for(int num : lotteryNumVect) cout << num << " ";
+	cout << endl;
+
+	// at still throws for a bad index
+	try{
+		lotteryNumVect.at(100);
+	}
+	catch(out_of_range& e){
+		cout << e.what() << " is out of range" << endl;
+	}
+
+	// A queue that goes in at the front and out at the back keeps running
+	// into the front end of the buffer. The elements are moved back into
+	// the middle instead of the buffer growing every time
+	GapVector <int> queue(10);
+	for(int i = 0; i < 1000000; i++){
+		queue.push_front(i);
+		queue.pop_back();
+	}
+
+	// Same with inserts in the middle while the front is popped
+	GapVector <int> middleQueue(10);
+	for(int i = 0; i < 1000000; i++){
+		middleQueue.insert(middleQueue.begin() + 5, i);
+		middleQueue.pop_front();
+	}
+
+	cout << "Capacity after a million pushes and pops " << queue.capacity()
+		<< " and " << middleQueue.capacity() << ", size " << queue.size() << endl;
+
+	// ---------- TIMING ----------
+	// Insert at the front and in a cluster near the middle
+
+	const int numInserts = 50000;
+
+	vector <int> vect;
+	GapVector <int> gapVect;
+
+	double vectFront = timeIt([&]{
+		for(int i = 0; i < numInserts; i++) vect.insert(vect.begin(), i);
+	});
+
+	double gapFront = timeIt([&]{
+		for(int i = 0; i < numInserts; i++) gapVect.push_front(i);
+	});
+
+	cout << "Front inserts vector " << vectFront << " ms GapVector "
+		<< gapFront << " ms" << endl;
+
+	// Each insert lands right after the one before it so the gap only has
+	// to move 1 slot each time
+	size_t middle = vect.size() / 2;
+
+	double vectMiddle = timeIt([&]{
+		for(int i = 0; i < numInserts; i++) vect.insert(vect.begin() + middle + i, i);
+	});
+
+	double gapMiddle = timeIt([&]{
+		for(int i = 0; i < numInserts; i++) gapVect.insert(gapVect.begin() + middle + i, i);
+	});
+
+	cout << "Clustered middle inserts vector " << vectMiddle << " ms GapVector "
+		<< gapMiddle << " ms" << endl;
+
+	// Close the gap and sum the elements as a plain array
+	long long vectSum = 0, gapSum = 0;
+	for(int num : vect) vectSum += num;
+
+	int* nums = gapVect.data();
+	for(size_t i = 0; i < gapVect.size(); i++) gapSum += nums[i];
+
+	cout << "Sums match " << (vectSum == gapSum) << endl;
+
+	return 0;
+}
@@ -0,0 +1,353 @@
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <initializer_list>
+#include <utility>
+#include <chrono>
+using namespace std;
+
+// Small Vectors
+// Every vector keeps its elements on the heap so even a vector holding 5
+// lottery numbers costs a call to new and a call to delete
+// A SmallVector<T, N> has room for N elements inside the object itself
+// Only when it grows past N does it ask its allocator for heap memory
+// Millions of short sequences then need no heap memory at all
+
+template <typename T, size_t N, typename Alloc = allocator<T>>
+class SmallVector{
+
+	private:
+		typedef allocator_traits<Alloc> Traits;
+
+		// Raw memory for N elements. Elements are only constructed in it
+		// as they are added
+		alignas(T) unsigned char inlineBuf[N * sizeof(T)];
+
+		T* first;
+		size_t count = 0;
+		size_t cap = N;
+		Alloc alloc;
+
+		T* inlineData(){ return reinterpret_cast<T*>(inlineBuf); }
+
+		// Move the elements into a bigger heap buffer
+		void reallocate(size_t newCap){
+
+			T* newData = Traits::allocate(alloc, newCap);
+			size_t i = 0;
+
+			try{
+				for(; i < count; i++)
+					Traits::construct(alloc, newData + i, move_if_noexcept(first[i]));
+			}
+			catch(...){
+				for(size_t j = 0; j < i; j++) Traits::destroy(alloc, newData + j);
+				Traits::deallocate(alloc, newData, newCap);
+				throw;
+			}
+
+			destroyAll();
+			releaseHeap();
+			first = newData;
+			cap = newCap;
+
+		}
+
+		void destroyAll(){
+			for(size_t i = 0; i < count; i++) Traits::destroy(alloc, first + i);
+		}
+
+		// Give the heap buffer back if we have one
+		void releaseHeap(){
+			if(!isInline()) Traits::deallocate(alloc, first, cap);
+		}
+
+		void growIfFull(){
+			if(count == cap) reallocate(cap * 2 > 0 ? cap * 2 : 1);
+		}
+
+	public:
+		typedef T value_type;
+		typedef T* iterator;
+		typedef const T* const_iterator;
+		typedef size_t size_type;
+		typedef Alloc allocator_type;
+
+		SmallVector() : first(inlineData()) {}
+
+		explicit SmallVector(const Alloc& a) : first(inlineData()), alloc(a) {}
+
+		// Like vector <int> v(10) this creates count value initialized elements
+		explicit SmallVector(size_t n, const T& value = T(), const Alloc& a = Alloc())
+			: first(inlineData()), alloc(a){
+			reserve(n);
+			for(size_t i = 0; i < n; i++) push_back(value);
+		}
+
+		SmallVector(initializer_list<T> values, const Alloc& a = Alloc())
+			: first(inlineData()), alloc(a){
+			reserve(values.size());
+			for(const T& value : values) push_back(value);
+		}
+
+		SmallVector(const SmallVector& other)
+			: first(inlineData()),
+			alloc(Traits::select_on_container_copy_construction(other.alloc)){
+			reserve(other.count);
+			for(const T& value : other) push_back(value);
+		}
+
+		// A heap buffer can be stolen, but inline elements have to be moved
+		// one at a time because they live inside the other object
+		SmallVector(SmallVector&& other) : first(inlineData()), alloc(move(other.alloc)){
+			if(other.isInline()){
+				for(T& value : other) push_back(move(value));
+				other.clear();
+			} else {
+				first = other.first;
+				count = other.count;
+				cap = other.cap;
+				other.first = other.inlineData();
+				other.count = 0;
+				other.cap = N;
+			}
+		}
+
+		SmallVector& operator=(const SmallVector& other){
+			if(this != &other){
+				clear();
+				reserve(other.count);
+				for(const T& value : other) push_back(value);
+			}
+			return *this;
+		}
+
+		SmallVector& operator=(SmallVector&& other){
+			if(this == &other) return *this;
+			clear();
+			if(!other.isInline() && alloc == other.alloc){
+				releaseHeap();
+				first = other.first;
+				count = other.count;
+				cap = other.cap;
+				other.first = other.inlineData();
+				other.count = 0;
+				other.cap = N;
+			} else {
+				reserve(other.count);
+				for(T& value : other) push_back(move(value));
+				other.clear();
+			}
+			return *this;
+		}
+
+		~SmallVector(){
+			destroyAll();
+			releaseHeap();
+		}
+
+		// True while the elements still live inside the object
+		bool isInline() const {
+			return first == reinterpret_cast<const T*>(inlineBuf);
+		}
+
+		size_t size() const { return count; }
+		size_t capacity() const { return cap; }
+		bool empty() const { return count == 0; }
+		Alloc get_allocator() const { return alloc; }
+
+		T* data(){ return first; }
+		const T* data() const { return first; }
+
+		iterator begin(){ return first; }
+		iterator end(){ return first + count; }
+		const_iterator begin() const { return first; }
+		const_iterator end() const { return first + count; }
+
+		T& operator[](size_t i){ return first[i]; }
+		const T& operator[](size_t i) const { return first[i]; }
+
+		T& at(size_t i){
+			if(i >= count) throw out_of_range("SmallVector::at");
+			return first[i];
+		}
+
+		T& front(){ return first[0]; }
+		T& back(){ return first[count - 1]; }
+
+		void reserve(size_t n){
+			if(n > cap) reallocate(n);
+		}
+
+		void push_back(const T& value){ emplace_back(value); }
+		void push_back(T&& value){ emplace_back(move(value)); }
+
+		template <typename... Args>
+		T& emplace_back(Args&&... args){
+
+			// If value refers to one of our own elements it has to be copied
+			// before the buffer moves so build it first
+			if(count == cap){
+				T temp(forward<Args>(args)...);
+				growIfFull();
+				Traits::construct(alloc, first + count, move(temp));
+			} else {
+				Traits::construct(alloc, first + count, forward<Args>(args)...);
+			}
+			return first[count++];
+
+		}
+
+		void pop_back(){
+			Traits::destroy(alloc, first + --count);
+		}
+
+		// Insert a value in front of pos and shift the rest up by one
+		iterator insert(const_iterator pos, T value){
+
+			size_t i = pos - first;
+			emplace_back(move(value));
+			for(size_t j = count - 1; j > i; j--) swap(first[j], first[j - 1]);
+			return first + i;
+
+		}
+
+		iterator erase(const_iterator pos){
+
+			size_t i = pos - first;
+			for(size_t j = i; j + 1 < count; j++) first[j] = move(first[j + 1]);
+			pop_back();
+			return first + i;
+
+		}
+
+		void resize(size_t n){
+			while(count > n) pop_back();
+			reserve(n);
+			while(count < n) emplace_back();
+		}
+
+		// clear keeps the heap buffer if we have one like vector does
+		void clear(){
+			destroyAll();
+			count = 0;
+		}
+
+};
+
+template <typename T, size_t N, typename A>
+bool operator==(const SmallVector<T, N, A>& a, const SmallVector<T, N, A>& b){
+
+	if(a.size() != b.size()) return false;
+	for(size_t i = 0; i < a.size(); i++) if(!(a[i] == b[i])) return false;
+	return true;
+
+}
+
+// An allocator that counts how often it is asked for memory so we can see
+// when the heap is being used
+static size_t numAllocations = 0;
+
+template <typename T>
+struct CountingAllocator{
+
+	typedef T value_type;
+
+	CountingAllocator() {}
+	template <typename U> CountingAllocator(const CountingAllocator<U>&) {}
+
+	T* allocate(size_t n){
+		numAllocations++;
+		return static_cast<T*>(::operator new(n * sizeof(T)));
+	}
+
+	void deallocate(T* p, size_t){ ::operator delete(p); }
+
+};
+
+template <typename T, typename U>
+bool operator==(const CountingAllocator<T>&, const CountingAllocator<U>&){ return true; }
+
+template <typename T, typename U>
+bool operator!=(const CountingAllocator<T>&, const CountingAllocator<U>&){ return false; }
+
+// Time how long it takes to run a function in milliseconds
+template <typename Func>
+double timeIt(Func func){
+
+	auto start = chrono::steady_clock::now();
+	func();
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count();
+
+}
+
+int main(){
+
+	// ---------- SMALL VECTOR BASICS ----------
+
+	int lotteryNumArray[5] = {4, 13, 14, 24, 34};
+
+	// Room for 5 ints inside the object
+	SmallVector <int, 5> draw;
+
+	for(int num : lotteryNumArray) draw.push_back(num);
+
+	cout << "Draw holds " << draw.size() << " numbers inline " << draw.isInline() << endl;
+
+	// The 6th number doesn't fit so the elements move to the heap
+	draw.push_back(44);
+
+	cout << "After a 6th number inline " << draw.isInline() << " capacity "
+		<< draw.capacity() << endl;
+
+	draw.insert(draw.begin(), 1);
+	draw.erase(draw.begin() + 2);
+
+	for(int num : draw) cout << num << " ";
+	cout << endl;
+
+	cout << "Value in 2 " << draw.at(2) << endl;
+
+	// Strings work too since elements are really constructed and destroyed
+	SmallVector <string, 2> names = {"Fred", "Tom"};
+	names.push_back("Spot");
+	cout << names.front() << " " << names.back() << endl;
+
+	// ---------- ALLOCATIONS AND TIMING ----------
+	// Build a million draws of 5 numbers with both containers
+
+	const int numDraws = 1000000;
+
+	numAllocations = 0;
+	long long vectSum = 0;
+
+	double vectTime = timeIt([&]{
+		for(int i = 0; i < numDraws; i++){
+			vector <int, CountingAllocator<int>> d;
+			for(int num : lotteryNumArray) d.push_back(num + i);
+			vectSum += d.back();
+		}
+	});
+
+	cout << "vector " << vectTime << " ms with " << numAllocations << " allocations" << endl;
+
+	numAllocations = 0;
+	long long smallSum = 0;
+
+	double smallTime = timeIt([&]{
+		for(int i = 0; i < numDraws; i++){
+			SmallVector <int, 5, CountingAllocator<int>> d;
+			for(int num : lotteryNumArray) d.push_back(num + i);
+			smallSum += d.back();
+		}
+	});
+
+	cout << "SmallVector " << smallTime << " ms with " << numAllocations << " allocations" << endl;
+
+	cout << "Sums match " << (vectSum == smallSum) << endl;
+
+	return 0;
+}
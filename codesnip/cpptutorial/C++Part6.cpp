@@ -0,0 +1,130 @@
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <limits>
+#include "Random.h"
+using namespace std;
+
+// Replacing rand()
+// Part1 generates numbers with (rand() % 100) + 1
+// rand() has one hidden state shared by the whole program, so threads can't
+// use it safely and it gives the same numbers every run unless you seed it
+// % also adds a bias. When the range doesn't divide the number of values
+// rand() can return, the first few numbers come up more often
+// The generators in Random.h keep their own state, can be seeded and can
+// hand each thread its own stream
+
+// Time how long it takes to run a function in seconds
+template <typename Func>
+double timeIt(Func func){
+
+	auto start = chrono::steady_clock::now();
+	func();
+	chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count();
+
+}
+
+int main(){
+
+	// ---------- THE WHILE LOOP WITH A SEEDED GENERATOR ----------
+	// The same seed always gives the same numbers so a run can be repeated
+
+	Xoshiro256pp gen(2024);
+
+	int randNum = uniformInt(gen, 1, 100);
+
+	while(randNum != 100){
+
+		cout << randNum << ", ";
+		randNum = uniformInt(gen, 1, 100);
+
+	}
+
+	cout << endl;
+
+	// A Pcg32 with a different stream number gives a different sequence
+	Pcg32 pcgA(2024, 1), pcgB(2024, 2);
+	cout << "Pcg32 streams " << uniformInt(pcgA, 1, 100) << " " << uniformInt(pcgB, 1, 100) << endl;
+
+	// Every int can come up, so about half of them are negative
+	int negatives = 0;
+	for(int i = 0; i < 1000; i++)
+		negatives += uniformInt(pcgA, numeric_limits<int>::min(), numeric_limits<int>::max()) < 0;
+	cout << "Any int, " << negatives << " of 1000 negative" << endl;
+
+	// ---------- MODULO BIAS ----------
+	// Take numbers in [0, 3000000000) from 32 bit values
+	// With % every number below 1294967296 can be reached 2 ways, the rest
+	// only 1 way, so the low third comes up twice as often
+
+	const uint32_t range = 3000000000U;
+	const int numSamples = 1000000;
+	int lowModulo = 0, lowLemire = 0;
+
+	for(int i = 0; i < numSamples; i++){
+		if(static_cast<uint32_t>(gen()) % range < range / 3) lowModulo++;
+		if(boundedRand(gen, range) < range / 3) lowLemire++;
+	}
+
+	cout << "Share in the low third, should be 0.333" << endl;
+	cout << "  with %      " << (double) lowModulo / numSamples << endl;
+	cout << "  with Lemire " << (double) lowLemire / numSamples << endl;
+
+	// ---------- ONE STREAM PER THREAD ----------
+	// Stream i starts 2^128 * i values into the sequence, so threads never
+	// share numbers and the results don't depend on how threads get scheduled
+
+	unsigned numThreads = thread::hardware_concurrency();
+	if(numThreads == 0) numThreads = 2;
+
+	vector <long long> hundreds(numThreads, 0);
+	vector <thread> workers;
+
+	for(unsigned t = 0; t < numThreads; t++){
+		workers.emplace_back([t, &hundreds]{
+			Xoshiro256pp local = Xoshiro256pp::forStream(2024, t);
+			for(int i = 0; i < 1000000; i++)
+				if(uniformInt(local, 1, 100) == 100) hundreds[t]++;
+		});
+	}
+
+	for(thread& worker : workers) worker.join();
+
+	for(unsigned t = 0; t < numThreads; t++)
+		cout << "Thread " << t << " rolled 100 " << hundreds[t] << " times" << endl;
+
+	// ---------- SPEED ----------
+	// Fill 64 MB of random numbers a few ways
+
+	const size_t count = 8 * 1024 * 1024;
+	vector <uint64_t> words(count);
+	vector <uint32_t> bounded(count);
+	const double megabytes = count * sizeof(uint64_t) / 1e6;
+
+	double randTime = timeIt([&]{
+		for(size_t i = 0; i < count; i++) bounded[i] = (rand() % 100) + 1;
+	});
+
+	cout << "rand() % 100 " << count * sizeof(uint32_t) / 1e6 / randTime / 1000 << " GB/s" << endl;
+
+	double scalarTime = timeIt([&]{ gen.fill(words.data(), count); });
+	cout << "Xoshiro256pp " << megabytes / scalarTime / 1000 << " GB/s" << endl;
+
+	Xoshiro256x4 wide(2024);
+
+	double wideTime = timeIt([&]{ wide.fill(words.data(), count); });
+	cout << "Xoshiro256x4 " << megabytes / wideTime / 1000 << " GB/s" << endl;
+
+	double boundedTime = timeIt([&]{ wide.fillBounded(bounded.data(), count, 100); });
+	cout << "Xoshiro256x4 in [0, 100) " << count * sizeof(uint32_t) / 1e6 / boundedTime / 1000
+		<< " GB/s" << endl;
+
+	// A range of 0 gives 0s instead of dividing by 0
+	wide.fillBounded(bounded.data(), 4, 0);
+	cout << "Range 0 " << bounded[0] << bounded[1] << bounded[2] << bounded[3] << endl;
+
+	return 0;
+}
@@ -0,0 +1,185 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include "Random.h"
+using namespace std;
+
+// Monte Carlo Simulation
+// The while loop in Part1 keeps drawing numbers between 1 and 100 until it
+// gets 100. How many draws that takes is the waiting time, and if we run the
+// loop many times the average waiting time tells us the odds of a hit
+// LotterySimulation runs that loop billions of times on every core
+//
+// The trials are split into fixed size chunks and chunk i always uses stream
+// i of the seed, so the results are the same no matter how many threads run
+// or which thread gets which chunk
+
+struct SimulationResult{
+
+	long long trials = 0;
+	long long draws = 0;
+
+	// waitCounts[w] is how many trials needed exactly w draws. The last
+	// bucket holds every waiting time that long or longer
+	vector <long long> waitCounts;
+
+	double sumWait = 0;
+	double sumWaitSquared = 0;
+	double seconds = 0;
+
+	// Add the counts of another result to this one
+	void merge(const SimulationResult& other){
+		trials += other.trials;
+		draws += other.draws;
+		sumWait += other.sumWait;
+		sumWaitSquared += other.sumWaitSquared;
+		for(size_t w = 0; w < waitCounts.size(); w++) waitCounts[w] += other.waitCounts[w];
+	}
+
+	double meanWait() const { return sumWait / trials; }
+
+	double stdDevWait() const {
+		double mean = meanWait();
+		return sqrt((sumWaitSquared - trials * mean * mean) / (trials - 1));
+	}
+
+	// Half the width of the 95% confidence interval for the mean
+	double marginOfError() const { return 1.96 * stdDevWait() / sqrt((double) trials); }
+
+};
+
+class LotterySimulation{
+
+	private:
+		int highestNumber;
+		int winningNumber;
+		uint64_t seed;
+		int maxWait;
+
+		static const long long chunkSize = 1 << 16;
+
+		// Run the trials of one chunk with that chunk's stream
+		void runChunk(Xoshiro256pp& gen, long long numTrials, SimulationResult& result) const {
+
+			long long* counts = result.waitCounts.data();
+
+			for(long long t = 0; t < numTrials; t++){
+
+				long long wait = 1;
+				while(uniformInt(gen, 1, highestNumber) != winningNumber) wait++;
+
+				counts[wait < maxWait ? wait : maxWait]++;
+				result.draws += wait;
+				result.sumWait += wait;
+				result.sumWaitSquared += (double) wait * wait;
+
+			}
+
+			result.trials += numTrials;
+
+		}
+
+	public:
+		LotterySimulation(int highestNumber, int winningNumber, uint64_t seed, int maxWait = 1000)
+			: highestNumber(highestNumber), winningNumber(winningNumber), seed(seed), maxWait(maxWait) {}
+
+		SimulationResult run(long long numTrials, unsigned numThreads) const {
+
+			auto start = chrono::steady_clock::now();
+
+			long long numChunks = (numTrials + chunkSize - 1) / chunkSize;
+			atomic <long long> nextChunk(0);
+
+			vector <SimulationResult> perThread(numThreads);
+			vector <thread> workers;
+
+			for(unsigned t = 0; t < numThreads; t++){
+				workers.emplace_back([&, t]{
+
+					SimulationResult& local = perThread[t];
+					local.waitCounts.assign(maxWait + 1, 0);
+
+					// A thread takes chunks in increasing order so it can
+					// reach the next chunk's stream by jumping forward from
+					// where it is instead of starting over
+					Xoshiro256pp streamStart(seed);
+					long long streamIndex = 0;
+
+					for(long long chunk = nextChunk++; chunk < numChunks; chunk = nextChunk++){
+
+						for(; streamIndex < chunk; streamIndex++) streamStart.jump();
+
+						Xoshiro256pp gen = streamStart;
+						long long remaining = numTrials - chunk * chunkSize;
+						runChunk(gen, remaining < chunkSize ? remaining : chunkSize, local);
+
+					}
+
+				});
+			}
+
+			for(thread& worker : workers) worker.join();
+
+			SimulationResult total;
+			total.waitCounts.assign(maxWait + 1, 0);
+			for(const SimulationResult& local : perThread) total.merge(local);
+
+			chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+			total.seconds = elapsed.count();
+			return total;
+
+		}
+
+};
+
+int main(int argc, char* argv[]){
+
+	// Pass the number of trials and threads on the command line to run a
+	// bigger simulation
+	long long numTrials = (argc > 1) ? atoll(argv[1]) : 10000000;
+	unsigned numThreads = (argc > 2) ? atoi(argv[2]) : thread::hardware_concurrency();
+	if(numThreads == 0) numThreads = 1;
+
+	// Draw numbers from 1 to 100 until we get 100 like Part1 does
+	LotterySimulation simulation(100, 100, 2024);
+
+	SimulationResult result = simulation.run(numTrials, numThreads);
+
+	cout << fixed << setprecision(4);
+	cout << "Trials " << result.trials << " Draws " << result.draws << " Threads "
+		<< numThreads << endl;
+	cout << "Time " << result.seconds << " s" << endl;
+	cout << setprecision(0);
+	cout << "Hits per second " << result.trials / result.seconds << endl;
+	cout << "Draws per second " << result.draws / result.seconds << endl;
+	cout << setprecision(4);
+
+	// A hit has a 1 in 100 chance so the true average wait is 100 draws
+	double mean = result.meanWait();
+	double margin = result.marginOfError();
+
+	cout << "Mean wait " << mean << " +/- " << margin << " (95%), expected 100" << endl;
+
+	// The odds of a hit are 1 over the mean wait
+	cout << "Odds of a hit 1 in " << mean << ", between 1 in " << mean - margin
+		<< " and 1 in " << mean + margin << endl;
+
+	// Compare the first few buckets with what the math says
+	// P(wait = w) = (99/100)^(w-1) * (1/100)
+	cout << "Wait  Observed  Expected" << endl;
+
+	for(int w = 1; w <= 5; w++){
+		double expected = pow(0.99, w - 1) * 0.01;
+		cout << setw(4) << w << "  " << (double) result.waitCounts[w] / result.trials
+			<< "    " << expected << endl;
+	}
+
+	cout << "Waits of 1000 or more " << result.waitCounts.back() << endl;
+
+	return 0;
+}
@@ -0,0 +1,270 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include "Random.h"
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// Bitset Lottery Tickets
+// A ticket like lotteryNumArray in Part1 is a list of numbers, so checking
+// it against a draw compares every number with every other one
+// If the numbers are 1 to 64 we can instead give each number one bit of a
+// 64 bit integer. Number 4 is bit 3, number 13 is bit 12 and so on
+// The numbers a ticket shares with the draw are then ticket & draw and how
+// many there are is the popcount (the number of 1 bits) of that
+// AVX-512 and AVX2 let us do that for a whole batch of tickets at once
+
+typedef uint64_t Ticket;
+
+// Games with up to 128 numbers use 2 words
+struct Ticket128{
+	uint64_t low;
+	uint64_t high;
+};
+
+Ticket makeTicket(const int* numbers, int count){
+
+	Ticket ticket = 0;
+	for(int i = 0; i < count; i++) ticket |= 1ULL << (numbers[i] - 1);
+	return ticket;
+
+}
+
+Ticket128 makeTicket128(const int* numbers, int count){
+
+	Ticket128 ticket = {0, 0};
+	for(int i = 0; i < count; i++){
+		int bit = numbers[i] - 1;
+		if(bit < 64) ticket.low |= 1ULL << bit;
+		else ticket.high |= 1ULL << (bit - 64);
+	}
+	return ticket;
+
+}
+
+void printTicket(Ticket ticket){
+
+	for(int bit = 0; bit < 64; bit++)
+		if(ticket & (1ULL << bit)) cout << bit + 1 << " ";
+	cout << endl;
+
+}
+
+// ---------- SCORING ----------
+// matches[i] is set to how many numbers tickets[i] shares with draw
+
+void scoreTicketsScalar(const Ticket* tickets, size_t n, Ticket draw, uint8_t* matches){
+
+	for(size_t i = 0; i < n; i++) matches[i] = __builtin_popcountll(tickets[i] & draw);
+
+}
+
+void scoreTickets(const Ticket* tickets, size_t n, Ticket draw, uint8_t* matches){
+
+	size_t i = 0;
+
+#if defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__)
+	// 8 tickets at a time. The counts are narrowed to bytes and stored in
+	// one instruction. The unmasked _mm512_cvtepi64_epi8 makes GCC warn
+	// about an uninitialized register
+	__m512i drawVec = _mm512_set1_epi64(draw);
+
+	for(; i + 8 <= n; i += 8){
+		__m512i shared = _mm512_and_si512(_mm512_loadu_si512(tickets + i), drawVec);
+		__m512i counts = _mm512_popcnt_epi64(shared);
+		_mm512_mask_cvtepi64_storeu_epi8(matches + i, 0xFF, counts);
+	}
+#elif defined(__AVX2__)
+	// AVX2 has no popcount instruction so look up the count of each 4 bit
+	// half of every byte in a table and add the bytes of each 64 bit lane
+	const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+		0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i lowNibble = _mm256_set1_epi8(0x0f);
+	__m256i drawVec = _mm256_set1_epi64x(draw);
+
+	auto countShared = [&](const Ticket* four){
+		__m256i shared = _mm256_and_si256(
+			_mm256_loadu_si256(reinterpret_cast<const __m256i*>(four)), drawVec);
+		__m256i low = _mm256_shuffle_epi8(table, _mm256_and_si256(shared, lowNibble));
+		__m256i high = _mm256_shuffle_epi8(table,
+			_mm256_and_si256(_mm256_srli_epi16(shared, 4), lowNibble));
+		return _mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256());
+	};
+
+	// The packs below leave the 16 counts in the order
+	// 0 4 1 5 8 12 9 13 2 6 3 7 10 14 11 15 and this shuffle sorts them
+	const __m128i order = _mm_setr_epi8(0, 2, 8, 10, 1, 3, 9, 11, 4, 6, 12, 14, 5, 7, 13, 15);
+
+	// 16 tickets at a time so the counts can be packed into one 16 byte store
+	for(; i + 16 <= n; i += 16){
+		__m256i ab = _mm256_or_si256(countShared(tickets + i),
+			_mm256_slli_epi64(countShared(tickets + i + 4), 32));
+		__m256i cd = _mm256_or_si256(countShared(tickets + i + 8),
+			_mm256_slli_epi64(countShared(tickets + i + 12), 32));
+		__m256i words = _mm256_packus_epi32(ab, cd);
+		__m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(words, words), 0x08);
+		__m128i sorted = _mm_shuffle_epi8(_mm256_castsi256_si128(bytes), order);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(matches + i), sorted);
+	}
+#endif
+
+	scoreTicketsScalar(tickets + i, n - i, draw, matches + i);
+
+}
+
+// The 128 bit version is 2 popcounts per ticket. The compiler vectorizes
+// this loop on its own when the target has a vector popcount
+void scoreTickets128(const Ticket128* tickets, size_t n, Ticket128 draw, uint8_t* matches){
+
+	for(size_t i = 0; i < n; i++){
+		matches[i] = __builtin_popcountll(tickets[i].low & draw.low) +
+			__builtin_popcountll(tickets[i].high & draw.high);
+	}
+
+}
+
+// ---------- RANKING ----------
+// There are C(49, 6) = 13983816 ways to pick 6 of 49 numbers so any such
+// ticket can be stored as its position in the sorted list of all of them
+// With the numbers as bit positions c1 < c2 < ... < ck the position is
+// C(c1, 1) + C(c2, 2) + ... + C(ck, k)
+
+class Combinations{
+
+	private:
+		// choose[n][k] is C(n, k)
+		uint64_t choose[65][65];
+
+	public:
+		Combinations(){
+			for(int n = 0; n <= 64; n++){
+				choose[n][0] = 1;
+				for(int k = 1; k <= 64; k++)
+					choose[n][k] = (n == 0) ? 0 : choose[n - 1][k - 1] + choose[n - 1][k];
+			}
+		}
+
+		uint64_t count(int n, int k) const { return choose[n][k]; }
+
+		uint64_t rank(Ticket ticket) const {
+
+			uint64_t result = 0;
+			int i = 1;
+			while(ticket){
+				int bit = __builtin_ctzll(ticket);
+				result += choose[bit][i++];
+				ticket &= ticket - 1;
+			}
+			return result;
+
+		}
+
+		// Work backwards from the biggest number. The largest bit whose
+		// C(bit, i) still fits in what is left of rank is the i-th number
+		Ticket unrank(uint64_t rank, int k) const {
+
+			Ticket ticket = 0;
+			int bit = 64;
+
+			for(int i = k; i >= 1; i--){
+				do { bit--; } while(choose[bit][i] > rank);
+				rank -= choose[bit][i];
+				ticket |= 1ULL << bit;
+			}
+
+			return ticket;
+
+		}
+
+};
+
+// A random 6 of 49 ticket. Keeps setting random bits until 6 are set
+Ticket randomTicket(Xoshiro256pp& gen, int highestNumber, int numbersPerTicket){
+
+	Ticket ticket = 0;
+	while(__builtin_popcountll(ticket) < numbersPerTicket)
+		ticket |= 1ULL << boundedRand(gen, highestNumber);
+	return ticket;
+
+}
+
+int main(int argc, char* argv[]){
+
+	// ---------- ONE TICKET ----------
+
+	int lotteryNumArray[6] = {4, 13, 14, 24, 34, 44};
+	int drawArray[6] = {2, 13, 24, 33, 34, 49};
+
+	Ticket ticket = makeTicket(lotteryNumArray, 6);
+	Ticket draw = makeTicket(drawArray, 6);
+
+	cout << "Ticket ";
+	printTicket(ticket);
+	cout << "Shared ";
+	printTicket(ticket & draw);
+	cout << "Matches " << __builtin_popcountll(ticket & draw) << endl;
+
+	int bigArray[3] = {4, 70, 128};
+	int bigDraw[3] = {70, 100, 128};
+	Ticket128 big = makeTicket128(bigArray, 3);
+	Ticket128 bigWin = makeTicket128(bigDraw, 3);
+	uint8_t bigMatches;
+	scoreTickets128(&big, 1, bigWin, &bigMatches);
+	cout << "Matches out of 128 numbers " << (int) bigMatches << endl;
+
+	// ---------- RANKING ----------
+
+	Combinations combos;
+	uint64_t ticketRank = combos.rank(ticket);
+
+	cout << "There are " << combos.count(49, 6) << " tickets of 6 from 49" << endl;
+	cout << "Our ticket is number " << ticketRank << endl;
+	cout << "Number " << ticketRank << " unranks to ";
+	printTicket(combos.unrank(ticketRank, 6));
+
+	// ---------- SCORING MANY TICKETS ----------
+	// Pass a ticket count on the command line for the 100 million run
+
+	size_t numTickets = (argc > 1) ? atoll(argv[1]) : 20000000;
+
+	Xoshiro256pp gen(2024);
+	vector <Ticket> tickets(numTickets);
+	for(Ticket& t : tickets) t = randomTicket(gen, 49, 6);
+
+	vector <uint8_t> matches(numTickets);
+	vector <uint8_t> scalarMatches(numTickets);
+
+	auto start = chrono::steady_clock::now();
+	scoreTicketsScalar(tickets.data(), numTickets, draw, scalarMatches.data());
+	chrono::duration<double, milli> scalarTime = chrono::steady_clock::now() - start;
+
+	start = chrono::steady_clock::now();
+	scoreTickets(tickets.data(), numTickets, draw, matches.data());
+	chrono::duration<double, milli> simdTime = chrono::steady_clock::now() - start;
+
+	cout << "Scored " << numTickets << " tickets" << endl;
+	cout << "  one at a time " << scalarTime.count() << " ms" << endl;
+	cout << "  in batches    " << simdTime.count() << " ms" << endl;
+	cout << "Results match " << (matches == scalarMatches) << endl;
+
+	// How many tickets got 0 to 6 numbers right
+	long long winners[7] = {0};
+	for(uint8_t m : matches) winners[m]++;
+
+	for(int m = 0; m <= 6; m++) cout << m << " matches " << winners[m] << endl;
+
+	// Storing ranks instead of bits only needs 24 bits per ticket for 6 of 49
+	bool roundTrip = true;
+	for(size_t i = 0; i < 1000; i++)
+		if(combos.unrank(combos.rank(tickets[i]), 6) != tickets[i]) roundTrip = false;
+
+	cout << "Rank and unrank round trip " << roundTrip << endl;
+
+	return 0;
+}
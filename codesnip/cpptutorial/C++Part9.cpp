@@ -0,0 +1,285 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include "Random.h"
+using namespace std;
+
+// Sampling Without Replacement
+// A lottery draw picks k different numbers from 1 to n
+// Calling rand() again whenever we get a number we already have works, but
+// it wastes draws and with rand() % n the numbers aren't equally likely
+// Here are 3 ways that use exactly one random number per pick
+//
+// FloydSampler     : Robert Floyd's algorithm. Best when k is small
+// PartialShuffler  : the first k steps of a Fisher-Yates shuffle
+// ReservoirSampler : keeps a fair sample of k items from a stream of
+//                    unknown length
+
+// Floyd's algorithm picks from 1..j for j = n-k+1 up to n. If the pick is
+// already taken it takes j instead, which can't be taken yet
+// Every set of k numbers comes out with the same chance
+class FloydSampler{
+
+	private:
+		int n;
+
+		// seen[i] is set while number i is in the current draw
+		vector <bool> seen;
+
+	public:
+		explicit FloydSampler(int n) : n(n), seen(n + 1, false) {}
+
+		template <typename Gen>
+		void draw(Gen& gen, int k, int* out){
+
+			int count = 0;
+
+			for(int j = n - k + 1; j <= n; j++){
+				int pick = 1 + boundedRand(gen, j);
+				if(seen[pick]) pick = j;
+				seen[pick] = true;
+				out[count++] = pick;
+			}
+
+			// Clear only the numbers we used so the next draw is O(k) too
+			for(int i = 0; i < k; i++) seen[out[i]] = false;
+
+		}
+
+};
+
+// The same idea for games with at most 64 numbers, keeping the taken
+// numbers as bits of a single word. The draw comes back as a bitset like
+// the Ticket in Part8
+template <typename Gen>
+uint64_t floydDraw64(Gen& gen, int n, int k){
+
+	uint64_t taken = 0;
+
+	for(int j = n - k; j < n; j++){
+		int bit = boundedRand(gen, j + 1);
+		uint64_t mask = 1ULL << bit;
+		taken |= (taken & mask) ? (1ULL << j) : mask;
+	}
+
+	return taken;
+
+}
+
+// A Fisher-Yates shuffle swaps position i with a random position from i on
+// Stopping after k swaps gives a fair draw in the first k slots
+// The pool doesn't need to be put back in order afterwards. Any order of
+// 1..n works as a starting point for the next draw
+class PartialShuffler{
+
+	private:
+		vector <int> pool;
+
+	public:
+		explicit PartialShuffler(int n) : pool(n){
+			for(int i = 0; i < n; i++) pool[i] = i + 1;
+		}
+
+		template <typename Gen>
+		void draw(Gen& gen, int k, int* out){
+
+			int n = pool.size();
+
+			for(int i = 0; i < k; i++){
+				int j = i + boundedRand(gen, n - i);
+				swap(pool[i], pool[j]);
+				out[i] = pool[i];
+			}
+
+		}
+
+};
+
+// Algorithm L for reservoir sampling
+// The simple way draws a random number for every item in the stream. This
+// one works out how many items to skip before the next one that goes into
+// the reservoir, so long streams cost almost nothing per item and offering a
+// whole block of items jumps straight over the skipped ones
+template <typename T>
+class ReservoirSampler{
+
+	private:
+		vector <T> reservoir;
+		size_t k;
+		long long seen = 0;
+		long long nextTake = 0;
+		double w = 1;
+		Xoshiro256pp gen;
+
+		// A uniform number in (0, 1)
+		double uniform(){ return ((gen() >> 11) + 0.5) * (1.0 / 9007199254740992.0); }
+
+		void scheduleNext(){
+			w *= exp(log(uniform()) / k);
+			nextTake += (long long) floor(log(uniform()) / log(1 - w)) + 1;
+		}
+
+	public:
+		ReservoirSampler(size_t k, uint64_t seed) : k(k), gen(seed) {
+			reservoir.reserve(k);
+		}
+
+		void offer(const T& item){ offer(&item, 1); }
+
+		void offer(const T* items, size_t count){
+
+			long long end = seen + count;
+
+			// Fill the reservoir with the first k items
+			while(seen < end && reservoir.size() < k){
+				reservoir.push_back(items[seen - (end - count)]);
+				seen++;
+				if(reservoir.size() == k){
+					nextTake = seen - 1;
+					scheduleNext();
+				}
+			}
+
+			// Only the chosen items are touched
+			while(nextTake < end){
+				reservoir[boundedRand(gen, k)] = items[nextTake - (end - count)];
+				scheduleNext();
+			}
+
+			seen = end;
+
+		}
+
+		const vector <T>& sample() const { return reservoir; }
+		long long itemsSeen() const { return seen; }
+
+};
+
+// Time how long it takes to run a function in seconds
+template <typename Func>
+double timeIt(Func func){
+
+	auto start = chrono::steady_clock::now();
+	func();
+	chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count();
+
+}
+
+// The largest difference between how often a number came up and how often
+// it should have, as a fraction of the expected count
+double worstDeviation(const vector <long long>& counts, double expected){
+
+	double worst = 0;
+	for(size_t i = 1; i < counts.size(); i++)
+		worst = max(worst, fabs(counts[i] - expected) / expected);
+	return worst;
+
+}
+
+int main(int argc, char* argv[]){
+
+	const int n = 49;
+	const int k = 6;
+	int draw[k];
+
+	Xoshiro256pp gen(2024);
+
+	// ---------- ONE DRAW EACH WAY ----------
+
+	FloydSampler floyd(n);
+	floyd.draw(gen, k, draw);
+	cout << "Floyd    ";
+	for(int num : draw) cout << num << " ";
+	cout << endl;
+
+	PartialShuffler shuffler(n);
+	shuffler.draw(gen, k, draw);
+	cout << "Shuffle  ";
+	for(int num : draw) cout << num << " ";
+	cout << endl;
+
+	uint64_t bits = floydDraw64(gen, n, k);
+	cout << "Bitset   ";
+	for(int bit = 0; bit < 64; bit++) if(bits & (1ULL << bit)) cout << bit + 1 << " ";
+	cout << endl;
+
+	// ---------- MILLIONS OF DRAWS ----------
+	// Pass the number of draws on the command line for a longer run
+
+	long long numDraws = (argc > 1) ? atoll(argv[1]) : 10000000;
+	double expected = (double) numDraws * k / n;
+
+	vector <long long> counts(n + 1, 0);
+	double floydTime = timeIt([&]{
+		for(long long d = 0; d < numDraws; d++){
+			floyd.draw(gen, k, draw);
+			for(int num : draw) counts[num]++;
+		}
+	});
+	cout << "Floyd     " << numDraws / floydTime / 1e6 << " million draws/s, worst deviation "
+		<< worstDeviation(counts, expected) << endl;
+
+	counts.assign(n + 1, 0);
+	double shuffleTime = timeIt([&]{
+		for(long long d = 0; d < numDraws; d++){
+			shuffler.draw(gen, k, draw);
+			for(int num : draw) counts[num]++;
+		}
+	});
+	cout << "Shuffle   " << numDraws / shuffleTime / 1e6 << " million draws/s, worst deviation "
+		<< worstDeviation(counts, expected) << endl;
+
+	counts.assign(n + 1, 0);
+	double bitsTime = timeIt([&]{
+		for(long long d = 0; d < numDraws; d++){
+			uint64_t taken = floydDraw64(gen, n, k);
+			while(taken){
+				counts[__builtin_ctzll(taken) + 1]++;
+				taken &= taken - 1;
+			}
+		}
+	});
+	cout << "Bitset    " << numDraws / bitsTime / 1e6 << " million draws/s, worst deviation "
+		<< worstDeviation(counts, expected) << endl;
+
+	// The old way. Keep calling rand() % n until we have k different numbers
+	counts.assign(n + 1, 0);
+	double randTime = timeIt([&]{
+		for(long long d = 0; d < numDraws; d++){
+			uint64_t taken = 0;
+			for(int i = 0; i < k; i++){
+				int num;
+				do { num = rand() % n + 1; } while(taken & (1ULL << num));
+				taken |= 1ULL << num;
+				counts[num]++;
+			}
+		}
+	});
+	cout << "rand()    " << numDraws / randTime / 1e6 << " million draws/s, worst deviation "
+		<< worstDeviation(counts, expected) << endl;
+
+	// ---------- RESERVOIR ----------
+	// Keep 10 fair picks from a stream of about 100 million numbers that arrives
+	// in blocks
+
+	ReservoirSampler <long long> sampler(10, 2024);
+	vector <long long> block(1 << 16);
+	long long next = 0;
+
+	double streamTime = timeIt([&]{
+		for(int b = 0; b < 1526; b++){
+			for(long long& item : block) item = next++;
+			sampler.offer(block.data(), block.size());
+		}
+	});
+
+	cout << "Reservoir of " << sampler.itemsSeen() << " items in " << streamTime << " s : ";
+	for(long long item : sampler.sample()) cout << item << " ";
+	cout << endl;
+
+	return 0;
+}
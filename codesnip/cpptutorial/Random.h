@@ -0,0 +1,298 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+// Random Number Generators
+// rand() keeps one hidden state for the whole program so threads fight over
+// it, and rand() % 100 makes small numbers a little more likely than big ones
+// This header has small generators that each keep their own state
+//
+// SplitMix64   : turns a single seed into well mixed starting states
+// Xoshiro256pp : the main 64 bit generator. jump() skips ahead 2^128 values
+//                so every thread can get its own stream from one seed
+// Pcg32        : a 32 bit generator with a tiny state
+// Xoshiro256x4 : 4 Xoshiro256pp streams side by side that fill arrays with
+//                AVX2 when it is available
+//
+// boundedRand() uses Lemire's multiply and shift method to give an unbiased
+// number in [0, range) without dividing in the common case
+
+#include <cstdint>
+#include <cstddef>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+class SplitMix64{
+
+	private:
+		uint64_t state;
+
+	public:
+		explicit SplitMix64(uint64_t seed) : state(seed) {}
+
+		uint64_t next(){
+			uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+			return z ^ (z >> 31);
+		}
+
+};
+
+class Xoshiro256pp{
+
+	private:
+		uint64_t s[4];
+
+		static uint64_t rotl(uint64_t x, int k){ return (x << k) | (x >> (64 - k)); }
+
+		// Moves the state ahead as if next() had been called many times.
+		// The polynomial decides how far
+		void jumpWith(const uint64_t (&poly)[4]){
+
+			uint64_t t[4] = {0, 0, 0, 0};
+
+			for(uint64_t word : poly){
+				for(int b = 0; b < 64; b++){
+					if(word & (1ULL << b)){
+						for(int i = 0; i < 4; i++) t[i] ^= s[i];
+					}
+					next();
+				}
+			}
+
+			for(int i = 0; i < 4; i++) s[i] = t[i];
+
+		}
+
+	public:
+		// So it can be used with the <random> distributions
+		typedef uint64_t result_type;
+		static constexpr uint64_t min(){ return 0; }
+		static constexpr uint64_t max(){ return ~0ULL; }
+
+		explicit Xoshiro256pp(uint64_t seed = 1){
+			SplitMix64 mixer(seed);
+			for(int i = 0; i < 4; i++) s[i] = mixer.next();
+		}
+
+		uint64_t next(){
+
+			uint64_t result = rotl(s[0] + s[3], 23) + s[0];
+			uint64_t t = s[1] << 17;
+
+			s[2] ^= s[0];
+			s[3] ^= s[1];
+			s[1] ^= s[2];
+			s[0] ^= s[3];
+			s[2] ^= t;
+			s[3] = rotl(s[3], 45);
+
+			return result;
+
+		}
+
+		uint64_t operator()(){ return next(); }
+
+		uint64_t stateWord(int i) const { return s[i]; }
+
+		// Same as calling next() 2^128 times
+		void jump(){
+			static const uint64_t poly[4] = {0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+				0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+			jumpWith(poly);
+		}
+
+		// Same as calling next() 2^192 times
+		void longJump(){
+			static const uint64_t poly[4] = {0x76e15d3efefdcbbfULL, 0xc5004e441c522fb3ULL,
+				0x77710069854ee241ULL, 0x39109bb02acbe635ULL};
+			jumpWith(poly);
+		}
+
+		// Stream number index of the generator seeded with seed. Streams
+		// never overlap so each thread can take its own index
+		static Xoshiro256pp forStream(uint64_t seed, unsigned index){
+			Xoshiro256pp gen(seed);
+			for(unsigned i = 0; i < index; i++) gen.jump();
+			return gen;
+		}
+
+		void fill(uint64_t* out, size_t n){
+			for(size_t i = 0; i < n; i++) out[i] = next();
+		}
+
+};
+
+class Pcg32{
+
+	private:
+		uint64_t state;
+		uint64_t inc;
+
+	public:
+		typedef uint32_t result_type;
+		static constexpr uint32_t min(){ return 0; }
+		static constexpr uint32_t max(){ return ~0U; }
+
+		// Generators with different streams give different sequences even
+		// with the same seed
+		explicit Pcg32(uint64_t seed = 1, uint64_t stream = 1) : state(0), inc((stream << 1) | 1){
+			next();
+			state += seed;
+			next();
+		}
+
+		uint32_t next(){
+
+			uint64_t old = state;
+			state = old * 6364136223846793005ULL + inc;
+			uint32_t xorShifted = static_cast<uint32_t>(((old >> 18) ^ old) >> 27);
+			uint32_t rot = static_cast<uint32_t>(old >> 59);
+			return (xorShifted >> rot) | (xorShifted << ((32 - rot) & 31));
+
+		}
+
+		uint32_t operator()(){ return next(); }
+
+};
+
+// A number in [0, range) with no modulo bias
+// x * range is a 64 bit number whose top 32 bits are the answer. Only when
+// the bottom 32 bits land in the small leftover zone do we need to divide
+// and possibly draw again
+template <typename Gen>
+uint32_t boundedRand(Gen& gen, uint32_t range){
+
+	uint32_t x = static_cast<uint32_t>(gen());
+	uint64_t m = static_cast<uint64_t>(x) * range;
+	uint32_t low = static_cast<uint32_t>(m);
+
+	if(low < range){
+		uint32_t threshold = -range % range;
+		while(low < threshold){
+			x = static_cast<uint32_t>(gen());
+			m = static_cast<uint64_t>(x) * range;
+			low = static_cast<uint32_t>(m);
+		}
+	}
+
+	return static_cast<uint32_t>(m >> 32);
+
+}
+
+// A number in [low, high] with no modulo bias
+// high - low doesn't fit an int when the range is most of the ints, so the
+// span is worked out unsigned. All 2^32 ints is a span boundedRand can't
+// take, and any 32 bits will do for it
+template <typename Gen>
+int uniformInt(Gen& gen, int low, int high){
+	uint32_t span = static_cast<uint32_t>(uint64_t(high) - uint64_t(low));
+	uint32_t offset = (span == UINT32_MAX) ? static_cast<uint32_t>(gen()) : boundedRand(gen, span + 1);
+	return static_cast<int>(static_cast<uint32_t>(low) + offset);
+}
+
+// 4 independent Xoshiro256pp streams stored lane by lane so one AVX2
+// register steps all 4 at once. Each lane is stream 0 to 3 of the seed so
+// the output is the same with or without AVX2
+class Xoshiro256x4{
+
+	private:
+		// s[word][lane]
+		alignas(32) uint64_t s[4][4];
+
+	public:
+		explicit Xoshiro256x4(uint64_t seed = 1){
+			Xoshiro256pp gen(seed);
+			for(int lane = 0; lane < 4; lane++){
+				for(int w = 0; w < 4; w++) s[w][lane] = gen.stateWord(w);
+				gen.jump();
+			}
+		}
+
+		// Writes n values. Values come out as lane 0, 1, 2, 3, lane 0, ...
+		void fill(uint64_t* out, size_t n){
+
+			size_t i = 0;
+
+#ifdef __AVX2__
+			__m256i s0 = _mm256_load_si256(reinterpret_cast<const __m256i*>(s[0]));
+			__m256i s1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(s[1]));
+			__m256i s2 = _mm256_load_si256(reinterpret_cast<const __m256i*>(s[2]));
+			__m256i s3 = _mm256_load_si256(reinterpret_cast<const __m256i*>(s[3]));
+
+			for(; i + 4 <= n; i += 4){
+				__m256i sum = _mm256_add_epi64(s0, s3);
+				__m256i rot = _mm256_or_si256(_mm256_slli_epi64(sum, 23), _mm256_srli_epi64(sum, 41));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_add_epi64(rot, s0));
+
+				__m256i t = _mm256_slli_epi64(s1, 17);
+				s2 = _mm256_xor_si256(s2, s0);
+				s3 = _mm256_xor_si256(s3, s1);
+				s1 = _mm256_xor_si256(s1, s2);
+				s0 = _mm256_xor_si256(s0, s3);
+				s2 = _mm256_xor_si256(s2, t);
+				s3 = _mm256_or_si256(_mm256_slli_epi64(s3, 45), _mm256_srli_epi64(s3, 19));
+			}
+
+			_mm256_store_si256(reinterpret_cast<__m256i*>(s[0]), s0);
+			_mm256_store_si256(reinterpret_cast<__m256i*>(s[1]), s1);
+			_mm256_store_si256(reinterpret_cast<__m256i*>(s[2]), s2);
+			_mm256_store_si256(reinterpret_cast<__m256i*>(s[3]), s3);
+#endif
+
+			// Scalar version of the same steps for machines without AVX2
+			// and for the last few values
+			for(; i < n; i += 4){
+				uint64_t block[4];
+				for(int lane = 0; lane < 4; lane++){
+					uint64_t sum = s[0][lane] + s[3][lane];
+					block[lane] = ((sum << 23) | (sum >> 41)) + s[0][lane];
+
+					uint64_t t = s[1][lane] << 17;
+					s[2][lane] ^= s[0][lane];
+					s[3][lane] ^= s[1][lane];
+					s[1][lane] ^= s[2][lane];
+					s[0][lane] ^= s[3][lane];
+					s[2][lane] ^= t;
+					s[3][lane] = (s[3][lane] << 45) | (s[3][lane] >> 19);
+				}
+				for(int lane = 0; lane < 4 && i + lane < n; lane++) out[i + lane] = block[lane];
+			}
+
+		}
+
+		// Fills out with unbiased numbers in [0, range). Each 64 bit value
+		// gives 2 candidates and the rare rejected ones are drawn again
+		// A range of 0 gives 0s like boundedRand does, without the divide
+		// by 0 the threshold would need
+		void fillBounded(uint32_t* out, size_t n, uint32_t range){
+
+			if(range == 0){
+				for(size_t i = 0; i < n; i++) out[i] = 0;
+				return;
+			}
+
+			const size_t chunk = 256;
+			uint64_t words[chunk];
+			uint32_t threshold = -range % range;
+			size_t done = 0;
+
+			while(done < n){
+				fill(words, chunk);
+				// The low half of each word first, then the high half
+				for(size_t j = 0; j < chunk && done < n; j++){
+					uint64_t m = (words[j] & 0xffffffffu) * range;
+					if(static_cast<uint32_t>(m) >= threshold) out[done++] = static_cast<uint32_t>(m >> 32);
+					if(done == n) break;
+					m = (words[j] >> 32) * range;
+					if(static_cast<uint32_t>(m) >= threshold) out[done++] = static_cast<uint32_t>(m >> 32);
+				}
+			}
+
+		}
+
+};
+
+#endif